@@ -0,0 +1,47 @@
+#pragma once
+
+#include <hmcos/core/graph.hpp>
+
+namespace hmcos {
+
+/// Make a value a view of its bases, so that it allocates no memory. Address
+/// of the view equals address of each base plus the paired offset. A base can
+/// be a view itself, so bases must be made views before values viewing them.
+void AddView(const ValueRef &view,
+             std::vector<std::pair<ValueRef, int64_t>> &&bases);
+
+/// Mark the only output of an op as fused into the kernel of its only use.
+/// Inputs of the op are used again through this value by that use.
+void AddFused(const ValueRef &val);
+
+/// Return the view over several owners that packs `owner` with other owners
+/// contiguously in memory, or `nullptr` if it is not packed.
+ValueRef PackOf(const ValueRef &owner);
+
+/// Owners packed together are placed as one block, which is allocated when
+/// the first of them is generated and freed when the last of them is killed.
+/// Return size of memory allocated or freed when `owner` is generated or
+/// killed, where `isAlive` tells whether another owner is alive at that time.
+template <class IsAlive>
+inline uint64_t PackedSize(const ValueRef &owner, const ValueRef &pack,
+                           IsAlive isAlive) {
+    if (!pack) return owner->type.Size();
+    for (auto &member : pack->owners)
+        if (member != owner && isAlive(member)) return 0;
+    return pack->type.Size();
+}
+
+/// Let each `Concat` op whose inputs are contiguous slices of its output
+/// write nothing. Its inputs are packed, and its output becomes a view of
+/// them. Inputs are not packed if any of them would begin at an offset not
+/// aligned by current `AlignPolicy`, which should be set before. Return the
+/// number of such ops.
+size_t MakeConcatViews(Graph &graph);
+
+/// Let outputs of ops which only reinterpret or slice their data input be
+/// views of it. These ops are `Identity`, `Reshape`-like ops, `Transpose` that
+/// keeps memory layout, and `Split` and `Slice` which produce contiguous
+/// slices. Return the number of such outputs.
+size_t MakeOutputViews(Graph &graph);
+
+}  // namespace hmcos
@@ -111,9 +111,22 @@ template <class Vert>
 class NodeNumberer : public DomTreeVisitor<Vert, Unit> {
 public:
     Unit Visit(const std::shared_ptr<DomNode<Vert>> &node) override {
+        // Number nodes with an explicit stack, since dominator trees of deep
+        // sequential graphs are as deep as the graphs themselves.
+        std::vector<std::pair<std::shared_ptr<DomNode<Vert>>, size_t>> stack;
         node->in = number++;
-        for (auto &child : node->children) Visit(child.lock());
-        node->out = number++;
+        stack.push_back({node, 0});
+        while (!stack.empty()) {
+            auto &[cur, childIdx] = stack.back();
+            if (childIdx == cur->children.size()) {
+                cur->out = number++;
+                stack.pop_back();
+                continue;
+            }
+            auto child = cur->children[childIdx++].lock();
+            child->in = number++;
+            stack.push_back({child, 0});
+        }
         return {};
     }
 
@@ -206,11 +219,18 @@ uint32_t DomBuilder<Vert>::eval(uint32_t v) {
 
 template <class Vert>
 void DomBuilder<Vert>::compress(uint32_t v) {
-    auto a = ancestor(v);
-    if (ancestor(a) == DfNodeType::NONE) return;
-    compress(a);
-    if (semi(best(a)) < semi(best(v))) best(v) = best(a);
-    ancestor(v) = ancestor(a);
+    // Collect the path to the root of the forest, excluding the root and its
+    // direct child
+    std::vector<uint32_t> path;
+    for (auto u = v; ancestor(ancestor(u)) != DfNodeType::NONE; u = ancestor(u))
+        path.push_back(u);
+
+    // Compress the path from top to bottom
+    for (auto it = path.rbegin(); it != path.rend(); it++) {
+        auto u = *it, a = ancestor(u);
+        if (semi(best(a)) < semi(best(u))) best(u) = best(a);
+        ancestor(u) = ancestor(a);
+    }
 }
 
 /// Add edge `(v, w)` to the forest
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <hmcos/core/registry.hpp>
 #include <hmcos/core/value.hpp>
 #include <hmcos/core/vertex.hpp>
 #include <hmcos/util/util.hpp>
@@ -51,13 +52,24 @@ struct Op : Vertex {
     std::string name;
     /// Type name of this op
     std::string type;
+    /// Interned type of this op, resolved on creation
+    OpKind kind;
     /// Input and output values of this operator
     std::vector<ValueRef> inputs, outputs;
+    /// Temporary memory needed only when this op runs, or null if it needs
+    /// none. It is defined by this op but never used.
+    ValueRef workspace;
 
     Op(const onnx::NodeProto *node)
-        : name(node->name()), type(node->op_type()) {}
+        : name(node->name()),
+          type(node->op_type()),
+          kind(OpRegistry::Get().Resolve(type)) {}
 
-    Op(const Op &other) : name(other.name), type(other.type) {}
+    Op(const Op &other)
+        : name(other.name), type(other.type), kind(other.kind) {}
+
+    /// Memory behavior of this op
+    const OpTraits &Traits() const { return OpRegistry::Get().Traits(kind); }
 
     static constexpr auto classKind = VertexKind::OP;
     VertexKind Kind() const override { return VertexKind::OP; }
@@ -65,6 +77,10 @@ struct Op : Vertex {
 
 using OpRef = std::shared_ptr<Op>;
 
+/// Whether the only output of this op can overlap one of the input
+uint32_t OverlapInput(const OpRef &op);
+static constexpr auto OVERLAP_FAILED = UINT32_MAX;
+
 struct Graph {
     // Name of this graph
     std::string name;
@@ -123,33 +139,56 @@ template <class Ret, class... Args>
 class VertexVisitor {
 public:
     virtual Ret Visit(const VertexRef &vert, Args... args) {
-        if (Contains(memo, vert)) return memo[vert];
-        Ret ret;
-        switch (vert->Kind()) {
-            case VertexKind::INPUT:
-                ret =
-                    VisitInput(Cast<Input>(vert), std::forward<Args>(args)...);
-                break;
-            case VertexKind::OUTPUT:
-                ret = VisitOutput(Cast<Output>(vert),
-                                  std::forward<Args>(args)...);
-                break;
-            case VertexKind::OP:
-                ret = VisitOp(Cast<Op>(vert), std::forward<Args>(args)...);
-                break;
-            default:
-                LOG(FATAL) << "Unreachable.";
+        auto memoIt = memo.find(vert);
+        if (memoIt != memo.end()) return memoIt->second;
+
+        // Visit dependencies in post-order with an explicit stack, so that
+        // visiting methods which call `Visit` on them only hit memoized
+        // results and never recurse deeper than one level.
+        std::vector<std::pair<VertexRef, bool>> stack{{vert, false}};
+        while (!stack.empty()) {
+            auto [cur, expanded] = stack.back();
+            if (expanded) {
+                stack.pop_back();
+                if (!Contains(memo, cur))
+                    memo.insert({cur, dispatch(cur, args...)});
+                continue;
+            }
+            stack.back().second = true;
+            auto deps = Deps(cur);
+            for (auto it = deps.rbegin(); it != deps.rend(); it++)
+                if (!Contains(memo, *it)) stack.push_back({*it, false});
         }
-        memo.insert({vert, ret});
-        return ret;
+
+        return memo[vert];
     }
 
+    /// Vertices that must be visited before `vert`. Visitors that call `Visit`
+    /// on neighbors inside visiting methods should return these neighbors here.
+    virtual std::vector<VertexRef> Deps(const VertexRef &vert) { return {}; }
+
     virtual Ret VisitInput(const InputRef &input, Args... args) = 0;
     virtual Ret VisitOutput(const OutputRef &output, Args... args) = 0;
     virtual Ret VisitOp(const OpRef &op, Args... args) = 0;
 
 protected:
     std::unordered_map<VertexRef, Ret> memo;
+
+private:
+    Ret dispatch(const VertexRef &vert, Args... args) {
+        switch (vert->Kind()) {
+            case VertexKind::INPUT:
+                return VisitInput(Cast<Input>(vert),
+                                  std::forward<Args>(args)...);
+            case VertexKind::OUTPUT:
+                return VisitOutput(Cast<Output>(vert),
+                                   std::forward<Args>(args)...);
+            case VertexKind::OP:
+                return VisitOp(Cast<Op>(vert), std::forward<Args>(args)...);
+            default:
+                LOG(FATAL) << "Unreachable.";
+        }
+    }
 };
 
 class VertexCloner : public VertexVisitor<VertexRef> {
@@ -158,6 +197,11 @@ public:
     VertexRef VisitOutput(const OutputRef &output) override;
     VertexRef VisitOp(const OpRef &op) override;
 
+    /// Predecessors of a vertex are cloned before the vertex itself.
+    std::vector<VertexRef> Deps(const VertexRef &vert) override {
+        return vert->Preds();
+    }
+
     virtual ValueRef VisitValue(const ValueRef &value);
 
 protected:
@@ -77,6 +77,39 @@ using HierOutputRef = std::shared_ptr<HierOutput>;
 
 struct Group;
 
+/// Memory behavior of an op precomputed for scheduling, so that memory changes
+/// only depend on which owners are killed by this op
+struct OpMemInfo {
+    /// Distinct owners of memory referred to by non-parameter inputs, with
+    /// numbers of their uses by this op
+    std::vector<std::pair<ValueRef, uint32_t>> owners;
+    /// Sizes of these owners
+    std::vector<uint64_t> sizes;
+    /// Packs of these owners, which are null if they are not packed. Size of
+    /// a packed owner is only freed with the last one of its pack.
+    std::vector<ValueRef> packs;
+    /// Total size of outputs owning memory alone, and size of workspace
+    uint64_t outSize = 0, wsSize = 0;
+    /// Packed outputs and their packs, which are allocated with the first
+    /// generated one of each pack
+    std::vector<std::pair<ValueRef, ValueRef>> outPacks;
+    /// Index of owner whose space can be reused by the output if it is killed
+    /// by this op
+    uint32_t overlap = OVERLAP_FAILED;
+
+    OpMemInfo(const OpRef &op);
+
+    /// Increase and decrease in memory when this op kills owners of total size
+    /// `killSize`, among which is the overlapped one if `ovlKilled`, and
+    /// allocates `packSize` for packed outputs
+    std::pair<uint64_t, uint64_t> IncDec(uint64_t killSize, bool ovlKilled,
+                                         uint64_t packSize = 0) const {
+        if (!ovlKilled)
+            return {outSize + packSize + wsSize, killSize + wsSize};
+        return {wsSize, killSize - sizes[overlap] + wsSize};
+    }
+};
+
 /// A sequence of ops
 /// All ops, except the first one, must only consume values produced by op in
 /// front of it.
@@ -90,6 +123,8 @@ struct Sequence : public HierVertex {
     std::vector<ValueRef> inputs, outputs;
     /// Group where this sequence resides in
     std::weak_ptr<Group> group;
+    /// Memory behavior of each op
+    std::vector<OpMemInfo> mems;
 
     Sequence(const OpRef &op);
 
@@ -200,34 +235,58 @@ public:
     virtual Ret VisitGroup(const GroupRef &group, Args... args) = 0;
 
     virtual Ret Visit(const HierVertRef &vert, Args... args) {
-        if (Contains(memo, vert)) return memo[vert];
-        Ret ret;
+        auto memoIt = memo.find(vert);
+        if (memoIt != memo.end()) return memoIt->second;
+
+        // Visit dependencies in post-order with an explicit stack, so that
+        // visiting methods which call `Visit` on them only hit memoized
+        // results and never recurse deeper than one level.
+        std::vector<std::pair<HierVertRef, bool>> stack{{vert, false}};
+        while (!stack.empty()) {
+            auto [cur, expanded] = stack.back();
+            if (expanded) {
+                stack.pop_back();
+                if (!Contains(memo, cur))
+                    memo.insert({cur, dispatch(cur, args...)});
+                continue;
+            }
+            stack.back().second = true;
+            auto deps = Deps(cur);
+            for (auto it = deps.rbegin(); it != deps.rend(); it++)
+                if (!Contains(memo, *it)) stack.push_back({*it, false});
+        }
+
+        return memo[vert];
+    }
+
+    /// Vertices that must be visited before `vert`. Visitors that call `Visit`
+    /// on neighbors inside visiting methods should return these neighbors here.
+    virtual std::vector<HierVertRef> Deps(const HierVertRef &vert) {
+        return {};
+    }
+
+protected:
+    std::unordered_map<HierVertRef, Ret> memo;
+
+private:
+    Ret dispatch(const HierVertRef &vert, Args... args) {
         switch (vert->Kind()) {
             case HierKind::INPUT:
-                ret = VisitInput(Cast<HierInput>(vert),
-                                 std::forward<Args>(args)...);
-                break;
-            case HierKind::OUTPUT:
-                ret = VisitOutput(Cast<HierOutput>(vert),
+                return VisitInput(Cast<HierInput>(vert),
                                   std::forward<Args>(args)...);
-                break;
+            case HierKind::OUTPUT:
+                return VisitOutput(Cast<HierOutput>(vert),
+                                   std::forward<Args>(args)...);
             case HierKind::SEQUENCE:
-                ret = VisitSequence(Cast<Sequence>(vert),
-                                    std::forward<Args>(args)...);
-                break;
+                return VisitSequence(Cast<Sequence>(vert),
+                                     std::forward<Args>(args)...);
             case HierKind::GROUP:
-                ret =
-                    VisitGroup(Cast<Group>(vert), std::forward<Args>(args)...);
-                break;
+                return VisitGroup(Cast<Group>(vert),
+                                  std::forward<Args>(args)...);
             default:
                 LOG(FATAL) << "Unreachable.";
         }
-        memo.insert({vert, ret});
-        return ret;
     }
-
-protected:
-    std::unordered_map<HierVertRef, Ret> memo;
 };
 
 /// Interface for passes on hierarchical graphs
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <hmcos/core/value.hpp>
+#include <limits>
+
+namespace hmcos {
+
+/// Interned op type. Each distinct type is assigned a kind by the registry when
+/// it is first resolved, which indexes traits of this type.
+enum class OpKind : uint32_t {};
+
+/// How outputs of an op may alias its inputs without any copy
+enum class AliasKind {
+    NONE,
+    /// Output has the same layout as the data input, e.g. `Reshape`
+    REINTERPRET,
+    /// Output keeps layout of the input if the permutation is trivial
+    TRANSPOSE,
+    /// Output may be a contiguous slice of the data input
+    SLICE,
+    /// Outputs may be consecutive slices of the data input
+    SPLIT,
+    /// Inputs may be consecutive slices of the output
+    CONCAT,
+};
+
+/// Size of temporary workspace in bytes that an op needs when it runs,
+/// computed from types of its inputs (parameters included) and outputs
+using WorkspaceFunc = std::function<uint64_t(
+    const std::vector<TensorType> &, const std::vector<TensorType> &)>;
+
+/// Memory behavior of an op type
+struct OpTraits {
+    std::string type;
+    /// The output may overwrite an input of the same size killed by this op
+    bool inPlace = false;
+    AliasKind alias = AliasKind::NONE;
+    /// This op can be fused into the kernel of the producer of one of its
+    /// inputs, e.g. `Relu` after `Conv`
+    bool fusible = false;
+    /// Cost of recomputing outputs of this op per input element it reads, or
+    /// infinity if they should never be recomputed, e.g. for `Conv`
+    double rematCost = std::numeric_limits<double>::infinity();
+    /// Empty if this op needs no workspace
+    WorkspaceFunc workspace;
+};
+
+/// Registry of memory behaviors of op types. Ops resolve their kinds when they
+/// are created, so the registry should be configured before graphs are loaded.
+class OpRegistry {
+public:
+    /// Create registry with traits of standard ONNX ops
+    OpRegistry();
+
+    /// Kind of an op type. Unknown types are registered with default traits.
+    OpKind Resolve(const std::string &type);
+
+    const OpTraits &Traits(OpKind kind) const {
+        return traits[uint32_t(kind)];
+    }
+
+    /// Traits of an op type, which can be modified
+    OpTraits &operator[](const std::string &type) {
+        return traits[uint32_t(Resolve(type))];
+    }
+
+    /// Define a workspace function that can be referred to in configs
+    void DefineWorkspace(const std::string &name, const WorkspaceFunc &func);
+
+    /// Load traits from a config file. Each line specifies all traits of an op
+    /// type in the form of:
+    /// `<type> [inplace] [fuse] [alias=<kind>] [remat=<cost>]
+    /// [workspace=<func>[*<scale>]]`
+    /// Alias kinds are lower-case names of `AliasKind`. Recomputation cost is
+    /// per input element. Workspace functions
+    /// are defined ones, `in<i>` or `out<i>` for size of the i-th input or
+    /// output, and `im2col` for convolution. Text after `#` is ignored.
+    void Load(const std::string &path);
+
+    static OpRegistry &Get();
+
+private:
+    WorkspaceFunc findWorkspace(const std::string &name) const;
+
+    std::vector<OpTraits> traits;
+    std::unordered_map<std::string, OpKind> kinds;
+    std::unordered_map<std::string, WorkspaceFunc> wsFuncs;
+};
+
+}  // namespace hmcos
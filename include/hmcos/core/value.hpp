@@ -28,6 +28,35 @@ enum DataType {
     BFLOAT16 = 16,
 };
 
+/// Alignment requirement of tensors in memory. Sizes of tensors are padded to
+/// multiples of their alignments, and memory planners place tensors at aligned
+/// offsets, so that estimated peaks match arenas that can be deployed.
+struct AlignPolicy {
+    /// Alignment of all data types in bytes
+    uint64_t global = 1;
+    /// Alignments of specific data types, overriding the global one
+    std::unordered_map<DataType, uint64_t> dtypes;
+
+    /// Alignment of a data type
+    uint64_t Alignment(DataType dtype) const;
+    /// Maximal alignment of all data types
+    uint64_t MaxAlignment() const;
+    /// Pad a size to a multiple of the alignment of a data type
+    uint64_t Pad(uint64_t size, DataType dtype) const {
+        auto align = Alignment(dtype);
+        return (size + align - 1) / align * align;
+    }
+
+    /// Parse policy from a string like `64,float16:32,int8:16`. The first
+    /// field is the global alignment, and the rest are per-type alignments.
+    static AlignPolicy Parse(const std::string &spec);
+
+    /// Policy used in all memory computations. It should be set before any
+    /// scheduling or planning, since sizes may be cached.
+    static const AlignPolicy &Get();
+    static void Set(const AlignPolicy &policy);
+};
+
 /// Internal storage of tensor type. In this project, all tensors must
 /// have concrete shapes.
 struct TensorType {
@@ -39,7 +68,9 @@ struct TensorType {
 
     /// Number of elements in this tensor
     uint64_t Count() const;
-    /// Size of this tensor in memory
+    /// Size of elements of this tensor in bytes
+    uint64_t RawSize() const;
+    /// Size of this tensor in memory, padded according to alignment policy
     uint64_t Size() const;
 
     bool operator==(const TensorType &other) const;
@@ -78,6 +109,19 @@ struct Value {
     /// than once.
     std::vector<std::weak_ptr<Op>> uses;
 
+    /// Memory aliasing of results. A view owns no memory. Its address equals
+    /// address of each base plus the offset paired with it.
+    std::vector<std::pair<std::shared_ptr<Value>, int64_t>> bases;
+    /// Valid for views. Values owning memory that this view refers to.
+    std::vector<std::shared_ptr<Value>> owners;
+    /// Views, direct or indirect, whose memory is owned by this value
+    std::vector<std::weak_ptr<Value>> views;
+    /// Valid for result. Whether this value is passed from its definition to
+    /// its only use inside a fused kernel, so it is never stored in memory.
+    /// It is a view without address, whose owners are those of inputs of its
+    /// definition, so they are kept alive until the end of the kernel.
+    bool fused = false;
+
     static Value CreateInput(const onnx::ValueInfoProto &info);
     static Value CreateParam(const onnx::TensorProto &tensor);
     static Value CreateResult(const onnx::ValueInfoProto &info);
@@ -86,7 +130,7 @@ struct Value {
 
     /// Clone from a value
     /// Usually used in vertex cloning, so all weak references to graph vertices
-    /// are not copied.
+    /// are not copied. Aliasing is not copied either.
     Value(const Value &other)
         : kind(other.kind),
           name(other.name),
@@ -95,8 +139,36 @@ struct Value {
 
     /// Return the vertex in graph where this value is defined.
     VertexRef Vertex() const;
+
+    bool IsView() const { return !bases.empty() || fused; }
+
+    /// Call `f` on each use of this value and its views. Memory owned by this
+    /// value is alive until all of them are done.
+    template <class F>
+    void ForEachMemUse(F f) const {
+        for (auto &use : uses) f(use);
+        for (auto &view : views)
+            for (auto &use : view.lock()->uses) f(use);
+    }
+
+    /// Number of uses of this value and its views
+    uint32_t MemUseCount() const {
+        uint32_t cnt = 0;
+        ForEachMemUse([&](auto &) { cnt++; });
+        return cnt;
+    }
 };
 
 using ValueRef = std::shared_ptr<Value>;
 
+/// Call `f` on each value owning memory of `val`, which is `val` itself
+/// unless it is a view
+template <class F>
+inline void ForEachOwner(const ValueRef &val, F f) {
+    if (!val->IsView())
+        f(val);
+    else
+        for (auto &owner : val->owners) f(owner);
+}
+
 }  // namespace hmcos
@@ -55,16 +55,54 @@ struct LifetimeStat {
               const std::string &format = "pdf") const;
 };
 
+/// Memory usage over the lifetime range, built once by sweeping over gen and
+/// kill events of values
+class MemoryTimeline {
+public:
+    MemoryTimeline(const LifetimeStat &stat);
+
+    /// Time range of this timeline, as a half-open interval
+    int32_t Begin() const { return begin; }
+    int32_t End() const { return begin + int32_t(profile.size()); }
+
+    /// Total size of values alive at time `t`
+    uint64_t SizeAt(int32_t t) const { return profile[t - begin]; }
+
+    /// Memory usage at each time, beginning from `Begin()`
+    const std::vector<uint64_t> &Profile() const { return profile; }
+
+    /// Maximal memory usage and times when it is reached
+    uint64_t Peak() const { return peak; }
+    std::vector<int32_t> PeakTimes() const;
+
+    /// Total size above budget summed over all the time of this timeline
+    uint64_t Excess(uint64_t budget) const;
+
+    /// Values alive at time `t`, in logarithmic time plus the number of them
+    std::vector<ValueRef> AliveValues(int32_t t) const;
+
+private:
+    const LifetimeStat &stat;
+    int32_t begin;
+    std::vector<uint64_t> profile;
+    uint64_t peak = 0;
+    /// Segment tree over time. Each node lists values alive through all the
+    /// time of the node, but not through its parent.
+    size_t nLeaves = 1;
+    std::vector<std::vector<uint32_t>> nodes;
+};
+
 class SizeIter {
 public:
-    SizeIter(int32_t t, const std::vector<Lifetime> &values)
-        : t(t), values(values) {}
+    SizeIter(int32_t t, const MemoryTimeline &timeline)
+        : t(t), timeline(timeline) {}
 
-    std::pair<int32_t, uint64_t> operator*();
+    std::pair<int32_t, uint64_t> operator*() const {
+        return {t, timeline.SizeAt(t)};
+    }
 
     std::vector<ValueRef> AliveValues() const {
-        return Transform<std::vector<ValueRef>>(
-            alive, [this](size_t i) { return values[i].value; });
+        return timeline.AliveValues(t);
     }
 
     void operator++() { t++; }
@@ -73,28 +111,59 @@ public:
 
 private:
     int32_t t;
-    size_t idx = 0;
-    uint64_t sum = 0;
-    const std::vector<Lifetime> &values;
-    std::vector<size_t> alive;
+    const MemoryTimeline &timeline;
 };
 
 class SizeRange {
 public:
-    SizeRange(const LifetimeStat &stat) : stat(stat) {}
+    SizeRange(const LifetimeStat &stat) : timeline(stat) {}
 
-    SizeIter begin() const { return {stat.range.first, stat.values}; }
-    SizeIter end() const { return {stat.range.second, stat.values}; }
+    SizeIter begin() const { return {timeline.Begin(), timeline}; }
+    SizeIter end() const { return {timeline.End(), timeline}; }
 
 private:
-    const LifetimeStat &stat;
+    MemoryTimeline timeline;
 };
 
 inline SizeRange LifetimeStat::SizeRange() const { return {*this}; }
 
-/// Whether the only output of this op can overlap one of the input
-uint32_t OverlapInput(const OpRef &op);
-static constexpr auto OVERLAP_FAILED = UINT32_MAX;
+/// A value alive at a memory peak
+struct PeakTensor {
+    /// Value and its lifetime in the schedule
+    Lifetime life;
+    /// Op producing this value, and the sequence that op is in. Both are null
+    /// for graph inputs.
+    OpRef def;
+    SequenceRef seq;
+    /// Number of ops executed since this value is produced
+    int32_t held;
+    /// Reduction of peak if lifetime of this value ends one op earlier
+    uint64_t saving;
+};
+
+/// A time when memory usage reaches the peak
+struct PeakPoint {
+    /// Time of this peak, and the op executed then (null for input time)
+    int32_t time;
+    OpRef op;
+    /// Values alive at this time, in descending order of size
+    std::vector<PeakTensor> tensors;
+};
+
+/// Explanation of what makes up memory peaks of a schedule
+struct PeakReport {
+    uint64_t peak;
+    std::vector<PeakPoint> points;
+
+    /// Write this report as a JSON object
+    void WriteJson(std::ostream &os) const;
+    /// Write this report to `<dir>/<name>.json`
+    void Dump(const std::string &dir, const std::string &name) const;
+};
+
+/// Find all the values alive at memory peaks of a complete schedule and
+/// attribute them to ops and sequences of the hierarchical graph.
+PeakReport ExplainPeaks(const std::vector<OpRef> &sched, const HierGraph &hier);
 
 /// Compute lifetime statistics of a complete op sequence of a graph.
 LifetimeStat ComputeLifetime(const std::vector<OpRef> &opSeq,
@@ -105,4 +174,62 @@ LifetimeStat ComputeLifetime(const std::vector<OpRef> &opSeq,
 uint64_t EstimatePeak(const std::vector<OpRef> &seq,
                       const std::vector<InputRef> &inputs);
 
+/// Dense indices of ops and values of a graph, for evaluating memory usage of
+/// many schedules without hashing
+struct OpValueIndex {
+    OpValueIndex(const Graph &graph);
+
+    /// Ops in graph, indexed by their ids
+    std::vector<OpRef> ops;
+    std::unordered_map<OpRef, uint32_t> opIds;
+    /// Total size of graph inputs, which is the memory usage before any op
+    uint64_t inputSize = 0;
+
+    /// Size, defining ops and using ops of each value. Inputs have no defining
+    /// op, and parameters are not indexed. Owners packed together are indexed
+    /// as one value of their block, defined by all their ops.
+    std::vector<uint64_t> sizes;
+    std::vector<std::vector<uint32_t>> defs;
+    std::vector<std::vector<uint32_t>> uses;
+
+    /// Distinct input values and output values of each op. Workspace of an op
+    /// is among both of them.
+    std::vector<std::vector<uint32_t>> inputs, outputs;
+    /// Input value whose space can be reused by the output of each op, if
+    /// this op kills it
+    std::vector<uint32_t> overlap;
+    /// Predecessor and successor ops of each op
+    std::vector<std::vector<uint32_t>> preds, succs;
+
+    static constexpr auto NONE = UINT32_MAX;
+};
+
+/// Estimate peaks of many complete schedules of a graph. Schedules are rows
+/// of a matrix of op ids, and are evaluated in parallel. Within each batch,
+/// memory changes of all schedules are accumulated together.
+class BatchPeakEstimator {
+public:
+    BatchPeakEstimator(const Graph &graph) : index(graph) {}
+
+    const OpValueIndex &Index() const { return index; }
+
+    /// Estimate peaks of schedules in a row-major matrix of op ids
+    std::vector<uint64_t> Estimate(const std::vector<uint32_t> &scheds) const;
+
+    /// Estimate peaks of schedules of ops
+    std::vector<uint64_t> Estimate(
+        const std::vector<std::vector<OpRef>> &scheds) const;
+
+private:
+    void estimateBatch(const uint32_t *scheds, size_t nScheds,
+                       uint64_t *peaks) const;
+
+    OpValueIndex index;
+};
+
+/// Compute a lower bound of peak memory usage of any schedule of the graph.
+/// When an op is executed, its inputs and outputs must be alive, so are the
+/// values defined by its ancestors and used by its descendants.
+uint64_t PeakLowerBound(const Graph &graph);
+
 }  // namespace hmcos
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <hmcos/sched/life.hpp>
+#include <hmcos/util/vec.hpp>
+
+namespace hmcos {
+
+/// Memory timeline of a complete schedule, which is updated incrementally
+/// when ops are moved. Memory usage at each op follows `EstimatePeak`.
+class PeakEvaluator {
+public:
+    PeakEvaluator(const std::vector<OpRef> &sched, const Graph &graph);
+
+    /// Peak memory usage of current schedule
+    uint64_t Peak() const {
+        return std::max(index.inputSize, uint64_t(timeline.Max()));
+    }
+
+    /// Current schedule
+    std::vector<OpRef> Schedule() const;
+
+    /// Range of positions op at `i` can be moved to without breaking
+    /// dependencies, as a closed interval
+    std::pair<size_t, size_t> MoveRange(size_t i) const;
+
+    /// Swap ops at `i` and `i + 1`, which must not depend on each other
+    void Swap(size_t i);
+
+    /// Move op at `from` to `to`, shifting ops in between by one. This is
+    /// also a move of the block in between to the other side of the op.
+    void Move(size_t from, size_t to);
+
+private:
+    /// Lifetime of value as a half-open interval of positions
+    std::pair<size_t, size_t> lifetime(uint32_t val) const;
+    void updateValues(const std::vector<uint32_t> &vals, int64_t sign);
+
+    /// Ops and values of graph
+    OpValueIndex index;
+    /// Op id at each position, and position of each op id
+    std::vector<uint32_t> order, pos;
+    /// Memory usage at each position
+    RangeMaxVec<int64_t> timeline;
+};
+
+/// Polish a complete schedule with simulated annealing, moving one op in each
+/// step. Peak of result is never higher than that of the given schedule.
+std::vector<OpRef> RefineSchedule(const std::vector<OpRef> &sched,
+                                  const Graph &graph, size_t nSteps,
+                                  std::mt19937 &rng);
+
+/// Polish a complete schedule to reduce its planned arena size. Arenas are
+/// planned with `GreedyBySize` during search, and moves are accepted if they
+/// do not enlarge the arena. Moves not touching lifetimes of blocks at the top
+/// of arena, and moves raising peak above current arena size, are rejected
+/// without planning. Result is compared with the given schedule by
+/// `PortfolioPlan`, and its arena is never larger.
+std::vector<OpRef> RefineArena(const std::vector<OpRef> &sched,
+                               const Graph &graph, size_t nSteps,
+                               std::mt19937 &rng);
+
+}  // namespace hmcos
@@ -2,22 +2,57 @@
 
 #include <hmcos/core/graph.hpp>
 #include <hmcos/util/util.hpp>
-#include <hmcos/util/vec.hpp>
+#include <memory>
 
 namespace hmcos {
 
+/// Node of a persistent rope of memory states. States are stored relative to
+/// memory usage right before the first state of this node. Nodes are never
+/// modified once shared, so they can be shared by many state vectors.
+struct MemStateNode {
+    /// Number of states in this node
+    size_t size = 0;
+    /// Maximal stable state and the last transient state
+    int64_t max = INT64_MIN, last = 0;
+
+    /// Children of an inner node. States of right child are offset by
+    /// `shift`.
+    std::shared_ptr<const MemStateNode> left, right;
+    int64_t shift = 0;
+
+    /// States of a leaf node
+    std::vector<int64_t> stables, transients;
+
+    MemStateNode() = default;
+
+    /// Concatenate two nodes, with memory increased by `gap` in between
+    MemStateNode(std::shared_ptr<const MemStateNode> left,
+                 std::shared_ptr<const MemStateNode> right, int64_t gap = 0);
+
+    /// Release descendants without recursion, as ropes can be very deep
+    ~MemStateNode();
+};
+
+using MemStateNodeRef = std::shared_ptr<const MemStateNode>;
+
 class MemStateIter;
 
 /// Vector of memory states
+/// States are stored in a rope, so copying and extending take constant time
+/// and prefixes are shared between copies. New states are appended to a tail
+/// leaf, which is copied on write if it is shared.
 class MemStateVec {
 public:
     MemStateVec(int64_t init = 0) : init(init) {}
 
-    int64_t Latest() const {
-        return transients.Empty() ? init : transients.Back();
-    }
+    int64_t Latest() const { return init + lastOf(root) + lastOf(tail); }
 
-    int64_t Peak() const { return stables.Empty() ? init : stables.Max(); }
+    int64_t Peak() const {
+        if (Size() == 0) return init;
+        auto max = maxOf(root);
+        if (tail) max = std::max(max, lastOf(root) + tail->max);
+        return init + max;
+    }
 
     std::pair<int64_t, int64_t> ComputeState(uint64_t inc, uint64_t dec) const {
         auto up = Latest() + inc;
@@ -27,11 +62,7 @@ public:
 
     /// Append one state to vector with memory increase when transitioned to
     /// transient state and decrease when transitioned to stable state
-    void Append(uint64_t inc, uint64_t dec) {
-        auto [up, down] = ComputeState(inc, dec);
-        stables.Append(up);
-        transients.Append(down);
-    }
+    void Append(uint64_t inc, uint64_t dec);
 
     /// Extend this state vector with the other vector
     /// State values in that vector will be offset by latest state of this
@@ -40,57 +71,79 @@ public:
 
     void Swap(MemStateVec& other) {
         std::swap(this->init, other.init);
-        this->stables.Swap(other.stables);
-        this->transients.Swap(other.transients);
+        this->root.swap(other.root);
+        this->tail.swap(other.tail);
     }
 
-    std::pair<int64_t, int64_t> operator[](size_t i) const {
-        LOG_ASSERT(i < Size());
-        return {stables[i], transients[i]};
-    }
+    std::pair<int64_t, int64_t> operator[](size_t i) const;
 
-    size_t Size() const { return stables.Size(); }
+    size_t Size() const { return sizeOf(root) + sizeOf(tail); }
 
     MemStateIter begin() const;
     MemStateIter end() const;
 
-    const StatVec<int64_t>& Stables() const { return stables; }
-    const StatVec<int64_t>& Transients() const { return transients; }
-
 private:
+    static size_t sizeOf(const MemStateNodeRef& node) {
+        return node ? node->size : 0;
+    }
+    static int64_t maxOf(const MemStateNodeRef& node) {
+        return node ? node->max : INT64_MIN;
+    }
+    static int64_t lastOf(const MemStateNodeRef& node) {
+        return node ? node->last : 0;
+    }
+
+    /// Move tail leaf into the rope
+    void seal();
+
     /// Initial memory offset
     int64_t init = 0;
-    /// Stable states, when an op is being executed
-    StatVec<int64_t> stables;
-    /// Transient states, when execution of the op has been finished
-    StatVec<int64_t> transients;
-};
+    /// States except those in tail
+    MemStateNodeRef root;
+    /// Leaf of latest appended states, relative to the end of root
+    std::shared_ptr<MemStateNode> tail;
 
-using I64VecConstIter = std::vector<int64_t>::const_iterator;
+    friend class MemStateIter;
+};
 
-class MemStateIter : public ZipIter<I64VecConstIter, I64VecConstIter> {
+/// Iterate (stable, transient) states of a state vector in order
+class MemStateIter {
 public:
-    MemStateIter(I64VecConstIter tIter, I64VecConstIter sIter)
-        : ZipIter(tIter, sIter) {}
-};
+    MemStateIter(const MemStateVec& vec, size_t index);
 
-inline MemStateIter MemStateVec::begin() const {
-    return {stables.begin(), transients.begin()};
-}
+    std::pair<int64_t, int64_t> operator*() const {
+        return {offset + leaf->stables[leafIdx],
+                offset + leaf->transients[leafIdx]};
+    }
 
-inline MemStateIter MemStateVec::end() const {
-    return {stables.end(), transients.end()};
-}
+    void operator++();
 
-inline void MemStateVec::Extend(const MemStateVec& other) {
-    auto last = Latest();
-    for (auto [t, s] : other) {
-        stables.Append(t + last);
-        transients.Append(s + last);
+    bool operator!=(const MemStateIter& other) const {
+        return this->index != other.index;
     }
-}
 
-/// Compute increase and decrease in memory when running an operator
+private:
+    /// Descend to the first leaf with states among pending nodes
+    void nextLeaf();
+
+    /// Nodes to be visited, and offsets of their states
+    std::vector<std::pair<const MemStateNode*, int64_t>> pending;
+    /// Current leaf and its offset
+    const MemStateNode* leaf = nullptr;
+    int64_t offset = 0;
+    size_t leafIdx = 0;
+    /// Index of current state in the vector
+    size_t index;
+};
+
+inline MemStateIter MemStateVec::begin() const { return {*this, 0}; }
+
+inline MemStateIter MemStateVec::end() const { return {*this, Size()}; }
+
+/// Compute increase and decrease in memory when running an operator. `killed`
+/// are distinct owners of memory whose last uses are this op. Workspace of the
+/// op is counted in both. Block of packed owners is counted in the increase of
+/// the first owner of the pack and the decrease of the last one.
 std::pair<uint64_t, uint64_t> ComputeIncDec(
     const OpRef& op, const std::vector<ValueRef>& killed);
 
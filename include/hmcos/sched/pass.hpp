@@ -7,7 +7,8 @@ namespace hmcos {
 /// Passes that perform transformations on hierarchical graphs to enable
 /// memory-aware scheduling
 
-/// Join continunous sequences to form a larger sequence
+/// Join continunous sequences to form a larger sequence. Sequences connected
+/// by fused values are always joined.
 class JoinSequencePass : public HierGraphPass {
 public:
     void Run(HierGraph &graph) override;
@@ -22,4 +23,23 @@ public:
     static std::function<bool(const SequenceRef &)> isCellOut;
 };
 
+/// Fuse ops into kernels of their producers, so that values passed between
+/// them are never stored in memory. A producer is fused with its consumer if
+/// its only output is only used by that op, and it is the only input of the
+/// consumer other than parameters. Fused ops are joined in one
+/// sequence, so they are scheduled back to back. Fusion is recorded in values
+/// of the graph. This pass must run before `MakeGroupPass`.
+class FuseOpsPass : public HierGraphPass {
+public:
+    void Run(HierGraph &graph) override;
+
+    /// Whether a consumer can be fused into kernel of its producer. By
+    /// default, consumers whose traits are fusible can be fused.
+    static std::function<bool(const OpRef &, const OpRef &)> canFuse;
+};
+
+/// Create a group from a convex set of top level sequences. Frontiers,
+/// entrances and exits are derived from current edges of the sequences.
+GroupRef GroupSequences(const std::unordered_set<SequenceRef> &seqs);
+
 }  // namespace hmcos
\ No newline at end of file
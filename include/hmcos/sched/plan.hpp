@@ -1,6 +1,9 @@
 #pragma once
 
+#include <functional>
 #include <hmcos/sched/life.hpp>
+#include <map>
+#include <set>
 
 namespace hmcos {
 
@@ -49,25 +52,20 @@ struct Step {
     }
 };
 
-inline bool CmpByBegin(const Step &lhs, const Step &rhs) {
-    return lhs.begin < rhs.begin;
-}
-
-inline bool CmpByOffset(const Step &lhs, const Step &rhs) {
-    return lhs.offset < rhs.offset;
-}
-
 /// Contains rectangular items
+/// Steps are kept in a balanced tree ordered by time, and in another ordered
+/// by offset, so that the lowest step can be found and any step updated in
+/// logarithmic time.
 class Container {
 public:
     Container(int32_t begin, int32_t end)
         : tBegin(begin), tEnd(end), maxHeight(0) {
-        steps.push_back({begin, end - begin, 0});
+        insertStep({begin, end - begin, 0});
     }
 
-    template <class Cmp>
-    const Step &FindMinBy(Cmp cmp) const {
-        return MinElem(steps, cmp);
+    /// Step with lowest offset. Earlier step is chosen if offsets are equal.
+    const Step &Lowest() const {
+        return steps.at(byOffset.begin()->second);
     }
 
     uint64_t GetMaxHeight() const { return maxHeight; }
@@ -81,33 +79,58 @@ public:
     /// Print steps in container
     void Print() const {
         fmt::print("Steps: \n");
-        for (auto &s : steps) fmt::print("{}\n", s.Format());
+        for (auto &[_, s] : steps) fmt::print("{}\n", s.Format());
         fmt::print("\n");
     }
 
 private:
-    /// Find index of the step at given time
-    int32_t findStepAt(int32_t time) const;
-    /// Try a number of times to merge a step with its next
-    void tryMerge(size_t beginIdx, uint32_t nTrial);
+    using StepIter = std::map<int32_t, Step>::iterator;
+
+    /// Find the step at given time
+    StepIter findStepAt(int32_t time);
+    /// Insert or erase a step in both trees
+    StepIter insertStep(const Step &step);
+    void eraseStep(StepIter it);
+    /// Merge a step with its neighbors if they have same offsets
+    void tryMerge(StepIter it);
 
     /// Temporal range of this container
     int32_t tBegin, tEnd;
     /// Maximal height of this container
     uint64_t maxHeight;
-    /// Steps in this container, sorted by time in increasing order
-    std::vector<Step> steps;
+    /// Steps in this container, indexed by beginning time
+    std::map<int32_t, Step> steps;
+    /// Offsets and beginning times of steps, ordered by offset
+    std::set<std::pair<uint64_t, int32_t>> byOffset;
 };
 
-template <class Elem, class Pred, class Cmp>
-inline auto MinPosWithConstr(const std::vector<Elem> &vec, Pred pred, Cmp cmp) {
-    std::optional<typename std::vector<Elem>::const_iterator> minPos;
-    for (auto it = vec.begin(); it != vec.end(); it++) {
-        if (!pred(*it)) continue;
-        if (!minPos.has_value() || cmp(*it, *minPos.value())) minPos = it;
-    }
-    return minPos;
-}
+/// Lifetimes of placed blocks indexed by a segment tree over time
+class IntervalTree {
+public:
+    IntervalTree(int32_t begin, int32_t end);
+
+    /// Insert lifetime [gen, kill) with given ID
+    void Insert(int32_t gen, int32_t kill, uint32_t id);
+
+    /// Append IDs of all inserted lifetimes overlapping [gen, kill) to `ids`.
+    /// Each ID is appended only once.
+    void Query(int32_t gen, int32_t kill, std::vector<uint32_t> &ids);
+
+private:
+    /// Call `f` on canonical nodes of [gen, kill)
+    template <class F>
+    void forCanonical(int32_t gen, int32_t kill, F f) const;
+
+    int32_t begin;
+    size_t nLeaves = 1;
+    /// Lifetimes covering the whole range of a node, but not its parent
+    std::vector<std::vector<uint32_t>> full;
+    /// Lifetimes covering only part of the range of a node
+    std::vector<std::vector<uint32_t>> partial;
+    /// Stamps for deduplicating nodes and IDs during one operation
+    std::vector<uint32_t> nodeStamps, idStamps;
+    uint32_t curStamp = 0;
+};
 
 struct MemoryPlan {
     /// Peak memory footprint
@@ -126,7 +149,51 @@ struct MemoryPlan {
               const std::string &format = "pdf");
 };
 
+/// Offsets of all planners below are aligned according to `AlignPolicy`.
+
 /// Implement best-fit heuristic by Sekiyama et al.
+/// Since blocks are stacked on each other, sizes of all blocks are padded to
+/// the maximal alignment of the policy.
 MemoryPlan BestFit(const LifetimeStat &stat);
 
+/// Default alignment of memory offsets in bytes
+static constexpr uint64_t DEFAULT_ALIGNMENT = 64;
+
+/// Place blocks in descending order of size, each at the lowest offset that
+/// does not conflict with blocks placed before. Offsets are aligned to both
+/// `alignment` and the alignment of data type in policy.
+MemoryPlan GreedyBySize(const LifetimeStat &stat,
+                        uint64_t alignment = DEFAULT_ALIGNMENT);
+
+/// Visit times in descending order of total size of values alive, and place
+/// unplaced blocks alive at each time in descending order of size.
+MemoryPlan GreedyByBreadth(const LifetimeStat &stat,
+                           uint64_t alignment = DEFAULT_ALIGNMENT);
+
+/// Place blocks in descending order of number of blocks whose lifetimes
+/// overlap them.
+MemoryPlan GreedyByConflict(const LifetimeStat &stat,
+                            uint64_t alignment = DEFAULT_ALIGNMENT);
+
+/// A named memory planning strategy
+struct Planner {
+    std::string name;
+    std::function<MemoryPlan(const LifetimeStat &)> plan;
+};
+
+/// All planners in the portfolio
+std::vector<Planner> AllPlanners();
+
+/// Arena size and running time of one planner in portfolio
+struct PlannerStat {
+    std::string name;
+    uint64_t size;
+    int64_t millis;
+};
+
+/// Run all planners concurrently and return the plan with smallest arena.
+/// Statistics of each planner are appended to `stats` if it is provided.
+MemoryPlan PortfolioPlan(const LifetimeStat &stat,
+                         std::vector<PlannerStat> *stats = nullptr);
+
 };  // namespace hmcos
\ No newline at end of file
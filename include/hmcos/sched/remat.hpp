@@ -0,0 +1,39 @@
+#pragma once
+
+#include <hmcos/sched/life.hpp>
+
+namespace hmcos {
+
+/// Cost of computing an op once more, or infinity if its outputs should never
+/// be recomputed
+using RematCostFunc = std::function<double(const OpRef &)>;
+
+/// Cost given by `rematCost` trait of the op, times the number of input
+/// elements it reads. By default, only element-wise ops, ops reinterpreting
+/// their inputs and pools are recomputed, with unit cost per element.
+double DefaultRematCost(const OpRef &op);
+
+/// Schedule in which some values are computed more than once
+struct RematResult {
+    /// Complete schedule of the graph, including recomputing ops
+    std::vector<OpRef> sched;
+    /// Lifetimes of values in this schedule
+    LifetimeStat stat;
+    /// Peak of memory usage according to lifetimes
+    uint64_t peak;
+    /// Ops added to the graph to recompute values, in the order they are added
+    std::vector<OpRef> remats;
+    /// Total cost of recomputation
+    double cost = 0;
+};
+
+/// Schedule the graph under a hard memory budget, trading computation for
+/// memory when no ordering fits. Values alive across the peak are recomputed
+/// right before their later uses, by ops duplicating their definitions that
+/// are added to the graph. Each step picks the recomputation that removes
+/// the most memory above budget per unit cost, until the peak fits or no
+/// recomputation helps, so the peak of result may still exceed the budget.
+RematResult RematSchedule(Graph &graph, uint64_t budget,
+                          const RematCostFunc &cost = DefaultRematCost);
+
+}  // namespace hmcos
@@ -15,8 +15,32 @@ std::vector<OpRef> RandomSample(const Graph &graph, std::mt19937 &rng);
 /// Produce reverse post-order sequence of a computation graph
 std::vector<OpRef> ReversePostOrder(const Graph &graph);
 
+/// Objective minimized by schedulers
+enum class SchedObjective {
+    /// Peak of total size of values alive
+    PEAK,
+    /// Arena size after memory planning, which also counts fragmentation
+    ARENA,
+};
+
 /// Use iterative hierarchical scheduling algorithm of HMCOS
-std::vector<OpRef> HierarchicalSchedule(const Graph &graph);
+std::vector<OpRef> HierarchicalSchedule(
+    const Graph &graph, SchedObjective objective = SchedObjective::PEAK);
+
+/// Schedule large graphs by sliding a window of `window` top level vertices
+/// along reverse post-order, and solving each window exactly with DP. Larger
+/// window produces better schedules at higher cost.
+std::vector<OpRef> WindowSchedule(const Graph &graph, size_t window = 16);
+
+/// Find a schedule whose peak does not exceed the budget. Search stops at the
+/// first such schedule found, or as soon as no schedule is proved to fit, in
+/// which case an empty sequence is returned.
+std::vector<OpRef> FeasibleSchedule(const Graph &graph, uint64_t budget);
+
+/// Find a schedule with minimal peak by bisection on feasible budget. The
+/// peak of result is within `tolerance` bytes from the minimal feasible one.
+std::vector<OpRef> BisectSchedule(const Graph &graph,
+                                  uint64_t tolerance = 1024);
 
 /// Serenity-style scheduling for networks with sequentially-connected cells
 std::vector<OpRef> SerenitySchedule(const Graph &graph, bool joinOps,
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <hmcos/sched/plan.hpp>
+
+namespace hmcos {
+
+/// Cost of moving a value between the fast tier and the slow tier
+struct TransferCost {
+    /// Bytes transferred per unit time
+    double bandwidth = 1;
+    /// Time of setting up each transfer
+    double latency = 0;
+
+    double operator()(uint64_t size) const {
+        return latency + double(size) / bandwidth;
+    }
+};
+
+enum class TierEventKind {
+    /// Run an op, with all its inputs and outputs in fast tier
+    OP,
+    /// Copy a value from fast tier to slow tier, after which the fast copy
+    /// is freed
+    SWAP_OUT,
+    /// Copy a value from slow tier back to fast tier, after which the slow
+    /// copy is freed
+    SWAP_IN,
+};
+
+/// Event of a schedule with two memory tiers
+struct TierEvent {
+    TierEventKind kind;
+    /// Valid for op events
+    OpRef op;
+    /// Valid for transfers. Each transfer creates a copy of a value in the
+    /// destination tier. Ops after a swap-in read the fast copy instead of the
+    /// original value, until it is swapped out again.
+    ValueRef src, dst;
+};
+
+/// Schedule of a graph on a small fast tier backed by a large slow tier
+struct TierSchedule {
+    /// Ops and transfers in order
+    std::vector<TierEvent> events;
+    /// Lifetimes of values and their copies in each tier, whose times are
+    /// indices of events
+    LifetimeStat fastStat, slowStat;
+    /// Memory plans of each tier
+    MemoryPlan fastPlan, slowPlan;
+    /// Total size and cost of all transfers
+    uint64_t transferBytes = 0;
+    double transferCost = 0;
+};
+
+/// Schedule the graph so that the arena of fast tier does not exceed the
+/// budget. If no ordering of ops fits, values alive across the peak are swapped
+/// out after their last use before the peak and swapped in before their next
+/// use. Each step picks the swap removing the most memory above budget per
+/// unit of transfer cost, until the fast arena fits or no swap helps.
+TierSchedule TieredSchedule(const Graph &graph, uint64_t budget,
+                            const TransferCost &cost = {});
+
+}  // namespace hmcos
@@ -1,11 +0,0 @@
-#pragma once
-
-#include <hmcos/util/util.hpp>
-
-namespace hmcos {
-
-bool IsElementWise(const std::string &name);
-
-bool IsReinterpret(const std::string &name);
-
-}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <functional>
+
+namespace hmcos {
+
+/// Run `func(i)` for each `i` in `[0, size)` on a pool of worker threads.
+/// Indices are handed out dynamically, so tasks of uneven cost are balanced
+/// across workers. Return after all tasks are finished.
+void ParallelFor(size_t size, const std::function<void(size_t)> &func);
+
+}  // namespace hmcos
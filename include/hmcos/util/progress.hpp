@@ -39,7 +39,7 @@ public:
     ProgressRange(size_t size) : size(size) {}
 
     auto begin() const {
-        PrintProgress(0, size, {});
+        if constexpr (display) PrintProgress(0, size, {});
         return ProgressIter<display>(0, size);
     }
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <limits>
 #include <vector>
 
@@ -40,4 +41,65 @@ private:
     Elem max = std::numeric_limits<Elem>::min();
 };
 
-}  // namespace hmcos
\ No newline at end of file
+/// Vector supporting addition to a range of elements and maximum query, both
+/// in logarithmic time. All elements are initially zero.
+template <class Elem>
+class RangeMaxVec {
+public:
+    RangeMaxVec(size_t size = 0)
+        : size(size), max(4 * size + 1, Elem()), add(4 * size + 1, Elem()) {}
+
+    size_t Size() const { return size; }
+
+    /// Add `delta` to elements in `[begin, end)`
+    void Add(size_t begin, size_t end, Elem delta) {
+        if (begin < end) addRange(1, 0, size, begin, end, delta);
+    }
+
+    /// Maximum of all elements
+    Elem Max() const {
+        return size == 0 ? std::numeric_limits<Elem>::lowest() : max[1];
+    }
+
+    /// Maximum of elements in `[begin, end)`
+    Elem Max(size_t begin, size_t end) const {
+        if (begin >= end) return std::numeric_limits<Elem>::lowest();
+        return queryRange(1, 0, size, begin, end);
+    }
+
+private:
+    void addRange(size_t node, size_t lo, size_t hi, size_t begin, size_t end,
+                  Elem delta) {
+        if (begin <= lo && hi <= end) {
+            max[node] += delta;
+            add[node] += delta;
+            return;
+        }
+        auto mid = (lo + hi) / 2;
+        if (begin < mid) addRange(2 * node, lo, mid, begin, end, delta);
+        if (mid < end) addRange(2 * node + 1, mid, hi, begin, end, delta);
+        max[node] = std::max(max[2 * node], max[2 * node + 1]) + add[node];
+    }
+
+    Elem queryRange(size_t node, size_t lo, size_t hi, size_t begin,
+                    size_t end) const {
+        if (begin <= lo && hi <= end) return max[node];
+        auto mid = (lo + hi) / 2;
+        auto result = std::numeric_limits<Elem>::lowest();
+        if (begin < mid)
+            result =
+                std::max(result, queryRange(2 * node, lo, mid, begin, end));
+        if (mid < end)
+            result =
+                std::max(result, queryRange(2 * node + 1, mid, hi, begin, end));
+        return result + add[node];
+    }
+
+    size_t size;
+    /// Maximum of each subtree, including additions on the subtree root
+    std::vector<Elem> max;
+    /// Additions applied to all elements of each subtree
+    std::vector<Elem> add;
+};
+
+}  // namespace hmcos
@@ -1,13 +1,17 @@
-#include <tensorflow/lite/simple_memory_arena.h>
-
 #include <chrono>
+#include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <hmcos/core/alias.hpp>
 #include <hmcos/sched/life.hpp>
+#include <hmcos/sched/local.hpp>
 #include <hmcos/sched/pass.hpp>
 #include <hmcos/sched/plan.hpp>
+#include <hmcos/sched/remat.hpp>
 #include <hmcos/sched/sched.hpp>
+#include <hmcos/sched/tier.hpp>
 #include <hmcos/util/viz.hpp>
+#include <sstream>
 
 using namespace hmcos;
 using namespace std::chrono;
@@ -22,13 +26,12 @@ using namespace std::chrono;
     }
 
 static uint64_t computeArenaSize(const LifetimeStat &stat) {
-    std::vector<tflite::ArenaAllocWithUsageInterval> allocs(stat.values.size());
-    TfLiteContext ctx;
-    tflite::SimpleMemoryArena arena(64);
-    for (auto [i, val] : EnumRange(stat.values))
-        arena.Allocate(&ctx, 64, val.value->type.Size(), i, val.gen,
-                       val.kill - 1, &allocs[i]);
-    return arena.RequiredBufferSize();
+    std::vector<PlannerStat> stats;
+    auto plan = PortfolioPlan(stat, &stats);
+    for (auto &s : stats)
+        LOG(INFO) << fmt::format("{}: {} KB, {} ms", s.name, s.size / 1024,
+                                 s.millis);
+    return plan.peak;
 }
 
 int main(int argc, char const *argv[]) {
@@ -37,6 +40,11 @@ int main(int argc, char const *argv[]) {
     google::LogToStderr();
     google::InitGoogleLogging(argv[0]);
 
+    // Load memory behaviors of ops, which are resolved when graph is built.
+    // Empty path or `-` keeps the builtin registry.
+    if (argc > 5 && std::strlen(argv[5]) > 0 && std::strcmp(argv[5], "-") != 0)
+        OpRegistry::Get().Load(argv[5]);
+
     // Build compitation graph from ONNX model
     std::ifstream ifs(argv[1], std::ifstream::binary);
     onnx::ModelProto model;
@@ -45,14 +53,85 @@ int main(int argc, char const *argv[]) {
     Graph graph(model, std::filesystem::path(argv[1]).stem().string());
     model.Clear();
 
-    // Schedule hierarchical graph
+    // Set alignment policy of tensors
+    if (argc > 3) AlignPolicy::Set(AlignPolicy::Parse(argv[3]));
+
+    // Memory options separated by commas, e.g. `alias,fuse,arena`
+    static const std::unordered_set<std::string> knownOptions{
+        "alias", "fuse", "arena", "swap"};
+    std::unordered_set<std::string> options;
+    std::stringstream ss(argc > 4 ? argv[4] : "");
+    std::string field;
+    while (std::getline(ss, field, ',')) {
+        if (field.empty()) continue;
+        if (!Contains(knownOptions, field))
+            LOG(FATAL) << fmt::format("Unknown option `{}`.", field);
+        options.insert(field);
+    }
+    auto hasOption = [&](const std::string &opt) {
+        return Contains(options, opt);
+    };
+
+    // Let ops write into memory of other values instead of copying
+    if (hasOption("alias")) {
+        LOG(INFO) << fmt::format("Concat views: {}", MakeConcatViews(graph));
+        LOG(INFO) << fmt::format("Output views: {}", MakeOutputViews(graph));
+    }
+
+    // Let ops pass values to their consumers inside fused kernels
+    if (hasOption("fuse")) {
+        HierGraph hier(graph);
+        RunPass<JoinSequencePass, FuseOpsPass>(hier);
+    }
+
+    // Schedule hierarchical graph, minimizing planned arena size instead of
+    // peak if required
+    auto objective =
+        hasOption("arena") ? SchedObjective::ARENA : SchedObjective::PEAK;
     std::vector<OpRef> sched;
-    TIME_CODE(sched = HierarchicalSchedule(graph);)
-    LOG(INFO) << "HMCOS Peak: " << EstimatePeak(sched, graph.inputs) / 1024 << " KB";
+    TIME_CODE(sched = HierarchicalSchedule(graph, objective);)
+    auto peak = EstimatePeak(sched, graph.inputs);
+    auto bound = PeakLowerBound(graph);
+    LOG(INFO) << "HMCOS Peak: " << peak / 1024 << " KB";
+    LOG(INFO) << "Peak Lower Bound: " << bound / 1024 << " KB";
+    auto gap = peak == 0 ? 0. : 100. * (double(peak) - double(bound)) / peak;
+    LOG(INFO) << fmt::format("HMCOS Optimality Gap: {:.2f}%", gap);
+    if (argc > 2) {
+        HierGraph hier(graph);
+        RunPass<JoinSequencePass, MakeGroupPass>(hier);
+        ExplainPeaks(sched, hier).Dump(argv[2], graph.name + "_peak");
+    }
     LOG(INFO) << "HMCOS Arena Size: " << computeArenaSize(ComputeLifetime(sched, graph)) / 1024 << " KB";
+
+    // Polish schedule with local search
+    std::mt19937 rng;
+    if (objective == SchedObjective::ARENA)
+        TIME_CODE(sched = RefineArena(sched, graph, 10 * sched.size(), rng);)
+    else
+        TIME_CODE(sched = RefineSchedule(sched, graph, 10 * sched.size(), rng);)
+    LOG(INFO) << "Refined Peak: " << EstimatePeak(sched, graph.inputs) / 1024 << " KB";
+    LOG(INFO) << "Refined Arena Size: " << computeArenaSize(ComputeLifetime(sched, graph)) / 1024 << " KB";
+
     sched = ReversePostOrder(graph);
     LOG(INFO) << "RPO Peak: " << EstimatePeak(sched, graph.inputs) / 1024 << " KB";
     LOG(INFO) << "RPO Arena Size: " << computeArenaSize(ComputeLifetime(sched, graph)) / 1024 << " KB";
 
+    // Swap values to slow memory, or recompute them, if no schedule fits the
+    // memory budget given in KB
+    if (argc > 6 && hasOption("swap")) {
+        auto budget = std::stoull(argv[6]) * 1024;
+        auto tiered = TieredSchedule(graph, budget);
+        LOG(INFO) << fmt::format(
+            "Tiered Arena Size: {} KB fast, {} KB slow, {} KB transferred",
+            tiered.fastPlan.peak / 1024, tiered.slowPlan.peak / 1024,
+            tiered.transferBytes / 1024);
+    } else if (argc > 6) {
+        auto budget = std::stoull(argv[6]) * 1024;
+        auto remat = RematSchedule(graph, budget);
+        LOG(INFO) << fmt::format("Remat Peak: {} KB, {} values recomputed",
+                                 remat.peak / 1024, remat.remats.size());
+        LOG(INFO) << "Remat Arena Size: " << computeArenaSize(remat.stat) / 1024 << " KB";
+    }
+
     return 0;
 }
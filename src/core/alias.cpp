@@ -0,0 +1,267 @@
+#include <hmcos/core/alias.hpp>
+#include <hmcos/util/fmt.hpp>
+#include <optional>
+
+namespace hmcos {
+
+void AddView(const ValueRef &view,
+             std::vector<std::pair<ValueRef, int64_t>> &&bases) {
+    LOG_ASSERT(!bases.empty());
+    if (view->IsView() || !view->views.empty())
+        LOG(FATAL) << fmt::format("Value {} is already aliased.", view->name);
+    view->bases = std::move(bases);
+    for (auto &[base, offset] : view->bases)
+        ForEachOwner(base,
+                     [&](auto &owner) { AddUnique(view->owners, owner); });
+    for (auto &owner : view->owners) owner->views.push_back(view);
+}
+
+void AddFused(const ValueRef &val) {
+    if (val->IsView() || !val->views.empty())
+        LOG(FATAL) << fmt::format("Value {} is already aliased.", val->name);
+    val->fused = true;
+    for (auto &in : val->def.lock()->inputs) {
+        if (in->kind == ValueKind::PARAM) continue;
+        ForEachOwner(in, [&](auto &owner) { AddUnique(val->owners, owner); });
+    }
+    for (auto &owner : val->owners) owner->views.push_back(val);
+}
+
+ValueRef PackOf(const ValueRef &owner) {
+    for (auto &weak : owner->views) {
+        auto view = weak.lock();
+        if (view->bases.size() > 1) return view;
+    }
+    return nullptr;
+}
+
+/// Whether inputs of a `Concat` op are contiguous slices of its output. The
+/// concatenation axis is where an input differs from the output, and all
+/// dimensions before it must be one.
+static bool slicesContiguous(const OpRef &op) {
+    auto &out = op->outputs[0]->type;
+    auto axis = out.shape.size();
+    for (auto &in : op->inputs) {
+        auto &shape = in->type.shape;
+        if (shape.size() != out.shape.size()) return false;
+        for (auto d = 0u; d < axis; d++) {
+            if (shape[d] == out.shape[d]) continue;
+            axis = d;
+            break;
+        }
+    }
+    if (axis == out.shape.size()) return false;
+    for (auto d = 0u; d < axis; d++)
+        if (out.shape[d] != 1) return false;
+
+    return std::transform_reduce(
+               op->inputs.begin(), op->inputs.end(), 0ull, std::plus(),
+               [](auto &in) { return in->type.RawSize(); }) == out.RawSize();
+}
+
+static std::unordered_set<ValueRef> graphOutputs(const Graph &graph) {
+    std::unordered_set<ValueRef> outVals;
+    for (auto &out : graph.outputs) outVals.insert(out->value);
+    return outVals;
+}
+
+size_t MakeConcatViews(Graph &graph) {
+    // A value can be packed only if it owns memory, and is neither aliased
+    // nor kept till the end as graph output
+    auto outVals = graphOutputs(graph);
+    auto canPack = [&](const ValueRef &val) {
+        return val->kind == ValueKind::RESULT && !val->IsView() &&
+               val->views.empty() && !Contains(outVals, val);
+    };
+
+    // Ops are stored in topological order, so bases are visited before views
+    size_t nViews = 0;
+    for (auto &op : graph.ops) {
+        if (op->Traits().alias != AliasKind::CONCAT || op->outputs.size() != 1)
+            continue;
+        if (op->inputs.size() < 2) continue;
+        auto &out = op->outputs[0];
+        if (!canPack(out)) continue;
+        std::unordered_set<ValueRef> distinct;
+        auto valid = std::all_of(
+            op->inputs.begin(), op->inputs.end(), [&](auto &in) {
+                return canPack(in) && in->type.dtype == out->type.dtype &&
+                       distinct.insert(in).second;
+            });
+        if (!valid || !slicesContiguous(op)) continue;
+
+        // Each input begins where the previous one ends in the output. Inputs
+        // cannot be packed if any of them would begin at a misaligned offset.
+        auto align = int64_t(AlignPolicy::Get().Alignment(out->type.dtype));
+        std::vector<std::pair<ValueRef, int64_t>> bases;
+        int64_t offset = 0;
+        for (auto &in : op->inputs) {
+            if (offset % align != 0) break;
+            bases.push_back({in, -offset});
+            offset += int64_t(in->type.RawSize());
+        }
+        if (bases.size() != op->inputs.size()) continue;
+        AddView(out, std::move(bases));
+        nViews++;
+    }
+
+    return nViews;
+}
+
+/// Dimensions whose sizes are not one
+static std::vector<int64_t> nonUnitDims(const std::vector<int64_t> &shape) {
+    std::vector<int64_t> dims;
+    for (auto d : shape)
+        if (d != 1) dims.push_back(d);
+    return dims;
+}
+
+/// Product of dimensions in [begin, end)
+static int64_t dimProduct(const std::vector<int64_t> &shape, size_t begin,
+                          size_t end) {
+    return std::accumulate(shape.begin() + begin, shape.begin() + end,
+                           int64_t(1), std::multiplies());
+}
+
+/// The only axis where `shape` differs from `base`, if their ranks are equal
+static std::optional<size_t> diffAxis(const std::vector<int64_t> &base,
+                                      const std::vector<int64_t> &shape) {
+    if (base.size() != shape.size()) return std::nullopt;
+    std::optional<size_t> axis;
+    for (auto d = 0u; d < base.size(); d++) {
+        if (base[d] == shape[d]) continue;
+        if (axis) return std::nullopt;
+        axis = d;
+    }
+    return axis;
+}
+
+/// Elements of an integer parameter, which is empty if not available
+static std::vector<int64_t> readInts(const ValueRef &val) {
+    if (val->kind != ValueKind::PARAM) return {};
+    auto count = val->type.Count();
+    auto &data = val->data;
+    if (val->type.dtype == DataType::INT64 && data.size() == count * 8) {
+        auto ptr = reinterpret_cast<const int64_t *>(data.data());
+        return {ptr, ptr + count};
+    }
+    if (val->type.dtype == DataType::INT32 && data.size() == count * 4) {
+        auto ptr = reinterpret_cast<const int32_t *>(data.data());
+        return {ptr, ptr + count};
+    }
+    return {};
+}
+
+/// Offset of the output of a `Slice` op in its data input, if the output is
+/// a contiguous slice of it. It is sliced with unit step along one axis, and
+/// all dimensions before that axis are one.
+static std::optional<int64_t> sliceOffset(const OpRef &op) {
+    auto &in = op->inputs[0]->type, &out = op->outputs[0]->type;
+    if (op->inputs.size() < 3) return std::nullopt;
+    if (op->inputs.size() > 4) {
+        auto steps = readInts(op->inputs[4]);
+        if (steps.empty() || std::any_of(steps.begin(), steps.end(),
+                                         [](auto s) { return s != 1; }))
+            return std::nullopt;
+    }
+    if (in.shape == out.shape) return 0;
+    auto axis = diffAxis(in.shape, out.shape);
+    if (!axis || dimProduct(in.shape, 0, *axis) != 1) return std::nullopt;
+    if (out.shape[*axis] == 0) return std::nullopt;
+
+    // Find start on this axis
+    auto starts = readInts(op->inputs[1]);
+    std::vector<int64_t> axes;
+    if (op->inputs.size() > 3) axes = readInts(op->inputs[3]);
+    if (axes.empty())
+        for (auto i = 0u; i < starts.size(); i++) axes.push_back(i);
+    if (axes.size() != starts.size()) return std::nullopt;
+    auto rank = int64_t(in.shape.size()), dim = in.shape[*axis];
+    for (auto [i, a] : EnumRange(axes)) {
+        if ((a + rank) % rank != int64_t(*axis)) continue;
+        auto start = starts[i] < 0 ? starts[i] + dim : starts[i];
+        start = std::clamp(start, int64_t(0), dim - out.shape[*axis]);
+        return start * int64_t(out.RawSize() / out.shape[*axis]);
+    }
+
+    return std::nullopt;
+}
+
+/// Offsets of outputs of an op in its data input, if all of them are views
+static std::vector<int64_t> viewOffsets(const OpRef &op) {
+    auto &in = op->inputs[0]->type;
+    auto alias = op->Traits().alias;
+
+    // Ops with one output of the same memory layout
+    if (op->outputs.size() == 1 &&
+        op->outputs[0]->type.RawSize() == in.RawSize()) {
+        auto &out = op->outputs[0]->type;
+        if (alias == AliasKind::REINTERPRET) return {0};
+        if (alias == AliasKind::TRANSPOSE) {
+            // Without permutation, memory layout is known to be kept only if
+            // dimensions other than one are distinct and in the same order
+            auto dims = nonUnitDims(in.shape);
+            auto sorted = dims;
+            std::sort(sorted.begin(), sorted.end());
+            if (dims == nonUnitDims(out.shape) &&
+                std::adjacent_find(sorted.begin(), sorted.end()) ==
+                    sorted.end())
+                return {0};
+            return {};
+        }
+    }
+
+    // Slices along an axis, with all dimensions before it being one
+    if (alias == AliasKind::SLICE && op->outputs.size() == 1) {
+        auto offset = sliceOffset(op);
+        if (offset) return {*offset};
+        return {};
+    }
+    if (alias == AliasKind::SPLIT) {
+        std::vector<int64_t> offsets;
+        int64_t offset = 0;
+        auto axis = diffAxis(in.shape, op->outputs[0]->type.shape);
+        if (axis && dimProduct(in.shape, 0, *axis) != 1) return {};
+        for (auto &out : op->outputs) {
+            if (diffAxis(in.shape, out->type.shape) != axis) return {};
+            offsets.push_back(offset);
+            offset += int64_t(out->type.RawSize());
+        }
+        if (offset != int64_t(in.RawSize())) return {};
+        return offsets;
+    }
+
+    return {};
+}
+
+size_t MakeOutputViews(Graph &graph) {
+    // A view can neither be aliased before nor kept as graph output
+    auto outVals = graphOutputs(graph);
+    auto canView = [&](const ValueRef &val) {
+        return !val->IsView() && val->views.empty() && !Contains(outVals, val);
+    };
+
+    // Ops are stored in topological order, so bases are visited before views
+    size_t nViews = 0;
+    for (auto &op : graph.ops) {
+        if (op->inputs.empty()) continue;
+        auto &data = op->inputs[0];
+        if (data->kind == ValueKind::PARAM || data->fused) continue;
+        if (!std::all_of(op->outputs.begin(), op->outputs.end(),
+                         [&](auto &out) {
+                             return canView(out) &&
+                                    out->type.dtype == data->type.dtype;
+                         }))
+            continue;
+        auto offsets = viewOffsets(op);
+        if (offsets.empty()) continue;
+        for (auto [out, offset] : ZipRange(op->outputs, offsets)) {
+            AddView(out, {{data, offset}});
+            nViews++;
+        }
+    }
+
+    return nViews;
+}
+
+}  // namespace hmcos
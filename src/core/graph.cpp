@@ -1,3 +1,4 @@
+#include <hmcos/core/alias.hpp>
 #include <hmcos/core/graph.hpp>
 #include <hmcos/util/fmt.hpp>
 #include <hmcos/util/viz.hpp>
@@ -5,6 +6,44 @@
 
 namespace hmcos {
 
+/// Create workspace of an op according to its traits
+static void createWorkspace(const OpRef &op) {
+    auto &func = op->Traits().workspace;
+    if (!func) return;
+    auto getType = [](const ValueRef &val) { return val->type; };
+    auto size =
+        func(Transform<std::vector<TensorType>>(op->inputs, getType),
+             Transform<std::vector<TensorType>>(op->outputs, getType));
+    if (size == 0) return;
+    auto ws = std::make_shared<Value>();
+    ws->kind = ValueKind::RESULT;
+    ws->name = op->name + ":workspace";
+    ws->type = TensorType{{int64_t(size)}, DataType::UINT8};
+    ws->def = op;
+    op->workspace = ws;
+}
+
+uint32_t OverlapInput(const OpRef &op) {
+    // Cannot handle multiple output op
+    if (op->outputs.size() > 1) return OVERLAP_FAILED;
+    // Packed owners are placed with each other, not with other values
+    auto &out = op->outputs[0];
+    if (out->IsView() || PackOf(out)) return OVERLAP_FAILED;
+
+    // Check if it can be computed in place
+    if (!op->Traits().inPlace) return OVERLAP_FAILED;
+
+    // The output value can only overlap the first input value with same size as
+    // it
+    for (auto [i, in] : EnumRange(op->inputs)) {
+        if (in->kind == ValueKind::PARAM || in->IsView() || PackOf(in))
+            continue;
+        if (in->type.Size() == out->type.Size()) return i;
+    }
+
+    return OVERLAP_FAILED;
+}
+
 Graph::Graph(const onnx::ModelProto &model, const std::string &name) {
     // Create name of this graph
     auto &graph = model.graph();
@@ -59,6 +98,7 @@ Graph::Graph(const onnx::ModelProto &model, const std::string &name) {
             op->outputs.push_back(outVal);
             outVal->def = op;
         }
+        createWorkspace(op);
         ops.push_back(op);
     }
 
@@ -103,6 +143,7 @@ VertexRef VertexCloner::VisitOp(const OpRef &op) {
         newOp->outputs.push_back(newOut);
         newOut->def = newOp;
     }
+    createWorkspace(newOp);
     return newOp;
 }
 
@@ -119,6 +160,7 @@ public:
 
     void Clone() {
         dst.name = src.name;
+        for (auto &in : src.inputs) Visit(in);
         for (auto &out : src.outputs) Visit(out);
         dst.ConnectVerts();
     }
@@ -138,7 +180,7 @@ public:
     VertexRef VisitOp(const OpRef &op) override {
         auto newOp = VertexCloner::VisitOp(op);
         dst.ops.push_back(As<Op>(newOp));
-        return op;
+        return newOp;
     }
 
     ValueRef VisitValue(const ValueRef &value) override {
@@ -159,19 +201,46 @@ Graph Graph::Clone() const {
     return dst;
 }
 
-class SubgraphExtractor : public VertexVisitor<VertexRef, bool> {
+class SubgraphExtractor : public VertexVisitor<VertexRef> {
 public:
     SubgraphExtractor(const Graph &src, Graph &dst,
                       std::function<bool(OpRef)> isOutput)
         : src(src), dst(dst), isOutput(isOutput) {}
 
     void Extract() {
-        for (auto &out : src.outputs) Visit(out, false);
+        // Mark output ops and all their ancestors with a worklist
+        std::vector<OpRef> work;
+        for (auto &op : src.ops)
+            if (isOutput(op)) work.push_back(op);
+        std::vector<OpRef> outOps = work;
+        while (!work.empty()) {
+            auto op = work.back();
+            work.pop_back();
+            if (!inGraph.insert(op).second) continue;
+            for (auto &in : op->inputs)
+                if (in->kind == ValueKind::RESULT)
+                    work.push_back(in->def.lock());
+        }
+
+        // Clone marked vertices in post-order of their predecessors
+        auto isUsed = [&](const InputRef &in) {
+            return std::any_of(
+                in->succs.begin(), in->succs.end(), [&](auto &succ) {
+                    return Is<Op>(succ) && Contains(inGraph, Cast<Op>(succ));
+                });
+        };
+        for (auto &in : src.inputs)
+            if (isUsed(in)) Visit(in);
+        for (auto &op : outOps) Visit(op);
         dst.ConnectVerts();
     }
 
-    VertexRef VisitInput(const InputRef &input, bool inGraph) override {
-        if (!inGraph) return nullptr;
+    std::vector<VertexRef> Deps(const VertexRef &vert) override {
+        if (!Is<Op>(vert) || !Contains(inGraph, Cast<Op>(vert))) return {};
+        return vert->Preds();
+    }
+
+    VertexRef VisitInput(const InputRef &input) override {
         auto newVal = VisitValue(input->value);
         auto newInput = std::make_shared<Input>(newVal);
         newVal->input = newInput;
@@ -179,40 +248,30 @@ public:
         return newInput;
     }
 
-    VertexRef VisitOutput(const OutputRef &output, bool) override {
-        Visit(output->value->Vertex(), false);
-        return nullptr;
-    }
+    VertexRef VisitOutput(const OutputRef &output) override { return nullptr; }
 
-    VertexRef VisitOp(const OpRef &op, bool inGraph) override {
+    VertexRef VisitOp(const OpRef &op) override {
+        auto newOp = std::make_shared<Op>(*op);
+        dst.ops.push_back(newOp);
+        for (auto &in : op->inputs) {
+            auto newIn = VisitValue(in);
+            newOp->inputs.push_back(newIn);
+            newIn->uses.push_back(newOp);
+        }
         auto isOut = this->isOutput(op);
-        inGraph |= isOut;
-        if (inGraph) {
-            auto newOp = std::make_shared<Op>(*op);
-            dst.ops.push_back(newOp);
-            for (auto &in : op->inputs) {
-                auto newIn = VisitValue(in);
-                newOp->inputs.push_back(newIn);
-                newIn->uses.push_back(newOp);
-                if (in->kind != ValueKind::PARAM) Visit(in->Vertex(), true);
-            }
-            for (auto &out : op->outputs) {
-                auto newOut = VisitValue(out);
-                newOp->outputs.push_back(newOut);
-                newOut->def = newOp;
-                if (isOut)
-                    dst.outputs.push_back(std::make_shared<Output>(newOut));
-            }
-            return newOp;
-        } else {
-            for (auto &in : op->inputs)
-                if (in->kind == ValueKind::RESULT) Visit(in->Vertex(), false);
-            return nullptr;
+        for (auto &out : op->outputs) {
+            auto newOut = VisitValue(out);
+            newOp->outputs.push_back(newOut);
+            newOut->def = newOp;
+            if (isOut) dst.outputs.push_back(std::make_shared<Output>(newOut));
         }
+        createWorkspace(newOp);
+        return newOp;
     }
 
     ValueRef VisitValue(const ValueRef &value) {
-        if (Contains(valueMap, value)) return valueMap[value];
+        auto it = valueMap.find(value);
+        if (it != valueMap.end()) return it->second;
         auto newVal = std::make_shared<Value>(*value);
         valueMap.insert({value, newVal});
         if (newVal->kind == ValueKind::PARAM) dst.params.push_back(newVal);
@@ -221,6 +280,7 @@ public:
 
 private:
     std::unordered_map<ValueRef, ValueRef> valueMap;
+    std::unordered_set<OpRef> inGraph;
     const Graph &src;
     Graph &dst;
     std::function<bool(OpRef)> isOutput;
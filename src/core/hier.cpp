@@ -1,13 +1,51 @@
+#include <hmcos/core/alias.hpp>
 #include <hmcos/core/hier.hpp>
 #include <hmcos/util/viz.hpp>
 
 namespace hmcos {
 
+OpMemInfo::OpMemInfo(const OpRef &op) {
+    // Count uses of owners. Views are used through their owners.
+    for (auto &in : op->inputs) {
+        if (in->kind == ValueKind::PARAM) continue;
+        ForEachOwner(in, [&](const ValueRef &owner) {
+            auto it = std::find_if(owners.begin(), owners.end(),
+                                   [&](auto &p) { return p.first == owner; });
+            if (it != owners.end())
+                it->second++;
+            else {
+                owners.push_back({owner, 1});
+                sizes.push_back(owner->type.Size());
+                packs.push_back(PackOf(owner));
+            }
+        });
+    }
+
+    // Views allocate no memory
+    for (auto &out : op->outputs) {
+        if (out->IsView()) continue;
+        auto pack = PackOf(out);
+        if (pack)
+            outPacks.push_back({out, pack});
+        else
+            outSize += out->type.Size();
+    }
+    if (op->workspace) wsSize = op->workspace->type.Size();
+
+    // Locate overlapped input among owners
+    auto ovlIdx = OverlapInput(op);
+    if (ovlIdx == OVERLAP_FAILED) return;
+    auto &ovlVal = op->inputs[ovlIdx];
+    for (auto [i, p] : EnumRange(owners))
+        if (p.first == ovlVal) overlap = uint32_t(i);
+}
+
 Sequence::Sequence(const OpRef &op)
     : ops{op},
       inputs(Filter<decltype(inputs)>(
           op->inputs, [](auto &val) { return val->kind != ValueKind::PARAM; })),
-      outputs(op->outputs) {}
+      outputs(op->outputs),
+      mems{OpMemInfo(op)} {}
 
 std::string Sequence::Label() const {
     return FmtList(
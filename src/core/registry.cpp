@@ -0,0 +1,168 @@
+#include <fstream>
+#include <hmcos/core/registry.hpp>
+#include <hmcos/util/fmt.hpp>
+#include <sstream>
+
+namespace hmcos {
+
+static const char *ewOps[]{
+    "Abs",        "Add",   "And",   "Neg",         "Mul",
+    "Exp",        "Div",   "Ceil",  "Not",         "LeakyRelu",
+    "Elu",        "Equal", "Floor", "Greater",     "HardSigmoid",
+    "Selu",       "Less",  "PRelu", "Log",         "Or",
+    "Reciprocal", "Pow",   "Relu",  "Sigmoid",     "Softplus",
+    "Softsign",   "Sqrt",  "Sub",   "Tanh",        "Xor",
+    "Acos",       "Asin",  "Atan",  "Cos",         "Sin",
+    "Tan",        "Sinh",  "Cosh",  "Asinh",       "Acosh",
+    "Atanh",      "Sign",  "Erf",   "Mod",         "ThresholdedRelu",
+    "BitShift",   "Round", "Celu",  "LessOrEqual", "GreaterOrEqual",
+    "HardSwish",  "Clip"};
+
+static const char *reinterpOps[]{"Squeeze", "Unsqueeze", "Reshape",
+                                 "Flatten"};
+
+static const char *poolOps[]{"MaxPool",       "AveragePool",
+                             "LpPool",        "GlobalMaxPool",
+                             "GlobalLpPool",  "GlobalAveragePool"};
+
+/// Size of column buffer of convolution lowered to matrix multiplication.
+/// Weight is `[M, C/g, k...]` and output is `[N, M, d...]`, so the buffer
+/// holds `C/g * prod(k)` rows of `N * prod(d)` elements. Convolution with
+/// unit kernel needs no such buffer.
+static uint64_t im2colSize(const std::vector<TensorType> &ins,
+                           const std::vector<TensorType> &outs) {
+    if (ins.size() < 2 || outs.empty()) return 0;
+    auto &weight = ins[1], &out = outs[0];
+    if (weight.shape.size() < 3 || out.shape.size() != weight.shape.size())
+        return 0;
+    if (weight.Count() == uint64_t(weight.shape[0] * weight.shape[1]))
+        return 0;
+    auto rows = weight.Count() / weight.shape[0];
+    auto cols = out.Count() / out.shape[1];
+    auto scalar = out.RawSize() / std::max<uint64_t>(out.Count(), 1);
+    return rows * cols * scalar;
+}
+
+OpRegistry::OpRegistry() {
+    for (auto type : ewOps) {
+        auto &t = (*this)[type];
+        t.inPlace = true;
+        t.fusible = true;
+        t.rematCost = 1;
+    }
+    for (auto type : reinterpOps) {
+        auto &t = (*this)[type];
+        t.inPlace = true;
+        t.alias = AliasKind::REINTERPRET;
+        t.rematCost = 1;
+    }
+    for (auto type : poolOps) (*this)[type].rematCost = 1;
+    (*this)["BatchNormalization"].fusible = true;
+    (*this)["Identity"].alias = AliasKind::REINTERPRET;
+    (*this)["Transpose"].alias = AliasKind::TRANSPOSE;
+    (*this)["Slice"].alias = AliasKind::SLICE;
+    (*this)["Split"].alias = AliasKind::SPLIT;
+    (*this)["Concat"].alias = AliasKind::CONCAT;
+    DefineWorkspace("im2col", im2colSize);
+}
+
+OpKind OpRegistry::Resolve(const std::string &type) {
+    auto it = kinds.find(type);
+    if (it != kinds.end()) return it->second;
+    auto kind = OpKind(traits.size());
+    traits.push_back({type});
+    kinds.insert({type, kind});
+    return kind;
+}
+
+void OpRegistry::DefineWorkspace(const std::string &name,
+                                 const WorkspaceFunc &func) {
+    wsFuncs[name] = func;
+}
+
+static const std::pair<const char *, AliasKind> aliasNames[]{
+    {"none", AliasKind::NONE},
+    {"reinterpret", AliasKind::REINTERPRET},
+    {"transpose", AliasKind::TRANSPOSE},
+    {"slice", AliasKind::SLICE},
+    {"split", AliasKind::SPLIT},
+    {"concat", AliasKind::CONCAT},
+};
+
+WorkspaceFunc OpRegistry::findWorkspace(const std::string &name) const {
+    auto it = wsFuncs.find(name);
+    if (it != wsFuncs.end()) return it->second;
+
+    // Size of an input or output
+    for (auto isIn : {true, false}) {
+        std::string prefix = isIn ? "in" : "out";
+        if (name.rfind(prefix, 0) != 0 || name.size() == prefix.size())
+            continue;
+        auto idxStr = name.substr(prefix.size());
+        if (!std::all_of(idxStr.begin(), idxStr.end(), ::isdigit)) continue;
+        auto idx = std::stoul(idxStr);
+        return [=](auto &ins, auto &outs) -> uint64_t {
+            auto &types = isIn ? ins : outs;
+            return idx < types.size() ? types[idx].RawSize() : 0;
+        };
+    }
+
+    LOG(FATAL) << fmt::format("Unknown workspace function `{}`.", name);
+    return nullptr;
+}
+
+void OpRegistry::Load(const std::string &path) {
+    std::ifstream ifs(path);
+    if (!ifs) LOG(FATAL) << fmt::format("Cannot open config {}.", path);
+    std::string line;
+    while (std::getline(ifs, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream ss(line);
+        std::string type, field;
+        if (!(ss >> type)) continue;
+
+        // Replace all traits of this type
+        OpTraits t{type};
+        while (ss >> field) {
+            auto eq = field.find('=');
+            auto key = field.substr(0, eq);
+            auto value = eq == std::string::npos ? "" : field.substr(eq + 1);
+            if (key == "inplace" && value.empty())
+                t.inPlace = true;
+            else if (key == "fuse" && value.empty())
+                t.fusible = true;
+            else if (key == "remat")
+                t.rematCost = std::stod(value);
+            else if (key == "alias") {
+                auto it = std::find_if(
+                    std::begin(aliasNames), std::end(aliasNames),
+                    [&](auto &p) { return value == p.first; });
+                if (it == std::end(aliasNames))
+                    LOG(FATAL)
+                        << fmt::format("Unknown alias kind `{}`.", value);
+                t.alias = it->second;
+            } else if (key == "workspace") {
+                auto star = value.find('*');
+                auto func = findWorkspace(value.substr(0, star));
+                if (star == std::string::npos)
+                    t.workspace = func;
+                else {
+                    auto scale = std::stod(value.substr(star + 1));
+                    t.workspace = [=](auto &ins, auto &outs) {
+                        return uint64_t(double(func(ins, outs)) * scale);
+                    };
+                }
+            } else
+                LOG(FATAL) << fmt::format("Unknown field `{}` of op {}.",
+                                          field, type);
+        }
+        (*this)[type] = std::move(t);
+    }
+}
+
+OpRegistry &OpRegistry::Get() {
+    static OpRegistry registry;
+    return registry;
+}
+
+}  // namespace hmcos
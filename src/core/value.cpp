@@ -1,6 +1,7 @@
 #include <hmcos/core/graph.hpp>
 #include <hmcos/core/value.hpp>
 #include <hmcos/util/fmt.hpp>
+#include <sstream>
 
 namespace hmcos {
 
@@ -84,7 +85,56 @@ uint64_t TensorType::Count() const {
         std::accumulate(shape.begin(), shape.end(), 1ll, std::multiplies()));
 }
 
-uint64_t TensorType::Size() const { return Count() * scalarSize[dtype]; }
+uint64_t TensorType::RawSize() const { return Count() * scalarSize[dtype]; }
+
+uint64_t TensorType::Size() const {
+    return AlignPolicy::Get().Pad(RawSize(), dtype);
+}
+
+uint64_t AlignPolicy::Alignment(DataType dtype) const {
+    auto it = dtypes.find(dtype);
+    return it == dtypes.end() ? global : it->second;
+}
+
+uint64_t AlignPolicy::MaxAlignment() const {
+    auto align = global;
+    for (auto &[_, a] : dtypes) align = std::max(align, a);
+    return align;
+}
+
+static uint64_t parseAlignment(const std::string &str) {
+    auto align = std::stoull(str);
+    if (align == 0) LOG(FATAL) << "Alignment must be positive.";
+    return align;
+}
+
+AlignPolicy AlignPolicy::Parse(const std::string &spec) {
+    AlignPolicy policy;
+    std::stringstream ss(spec);
+    std::string field;
+    std::getline(ss, field, ',');
+    policy.global = parseAlignment(field);
+    while (std::getline(ss, field, ',')) {
+        auto colon = field.find(':');
+        if (colon == std::string::npos)
+            LOG(FATAL) << fmt::format("Expect `<type>:<alignment>`, got `{}`.",
+                                      field);
+        auto name = field.substr(0, colon);
+        auto dtype = -1;
+        for (auto i = 0; i <= DataType::BFLOAT16; i++)
+            if (FmtDataType(i) == name) dtype = i;
+        if (dtype < 0) LOG(FATAL) << fmt::format("Unknown data type {}.", name);
+        auto align = parseAlignment(field.substr(colon + 1));
+        policy.dtypes[DataType(dtype)] = align;
+    }
+    return policy;
+}
+
+static AlignPolicy globalPolicy;
+
+const AlignPolicy &AlignPolicy::Get() { return globalPolicy; }
+
+void AlignPolicy::Set(const AlignPolicy &policy) { globalPolicy = policy; }
 
 bool TensorType::operator==(const TensorType &other) const {
     if (this->dtype != other.dtype) return false;
@@ -1,5 +1,6 @@
+#include <hmcos/core/alias.hpp>
 #include <hmcos/sched/life.hpp>
-#include <hmcos/util/op.hpp>
+#include <hmcos/util/parallel.hpp>
 #include <hmcos/util/viz.hpp>
 
 namespace hmcos {
@@ -14,40 +15,201 @@ void LifetimeStat::Plot(const std::string &dir, const std::string &name,
     plot.Render(dir, format);
 }
 
-std::pair<int32_t, uint64_t> SizeIter::operator*() {
-    while (idx < values.size() && values[idx].gen == t) {
-        alive.push_back(idx);
-        sum += values[idx].value->type.Size();
-        idx++;
+MemoryTimeline::MemoryTimeline(const LifetimeStat &stat)
+    : stat(stat), begin(stat.range.first) {
+    // Accumulate size deltas of gen and kill events
+    auto len = size_t(stat.range.second - begin);
+    std::vector<int64_t> delta(len + 1, 0);
+    auto clamp = [&](int32_t t) {
+        return size_t(std::min(std::max(t, begin), stat.range.second) - begin);
+    };
+    for (auto &life : stat.values) {
+        auto size = int64_t(life.value->type.Size());
+        delta[clamp(life.gen)] += size;
+        delta[clamp(life.kill)] -= size;
     }
-    RemoveIf(alive, [this](size_t i) {
-        auto &block = values[i];
-        if (block.kill == t) {
-            sum -= block.value->type.Size();
-            return true;
-        } else
-            return false;
-    });
-    return {t, sum};
+    profile.resize(len);
+    int64_t sum = 0;
+    for (auto i = 0u; i < len; i++) {
+        sum += delta[i];
+        profile[i] = uint64_t(sum);
+        peak = std::max(peak, profile[i]);
+    }
+
+    // Insert each lifetime into canonical nodes of the segment tree
+    while (nLeaves < len) nLeaves <<= 1;
+    nodes.resize(2 * nLeaves);
+    for (auto i = 0u; i < stat.values.size(); i++) {
+        auto &life = stat.values[i];
+        auto l = clamp(life.gen) + nLeaves, r = clamp(life.kill) + nLeaves;
+        for (; l < r; l >>= 1, r >>= 1) {
+            if (l & 1) nodes[l++].push_back(i);
+            if (r & 1) nodes[--r].push_back(i);
+        }
+    }
+}
+
+std::vector<int32_t> MemoryTimeline::PeakTimes() const {
+    std::vector<int32_t> times;
+    for (auto i = 0u; i < profile.size(); i++)
+        if (profile[i] == peak) times.push_back(begin + int32_t(i));
+    return times;
+}
+
+uint64_t MemoryTimeline::Excess(uint64_t budget) const {
+    uint64_t excess = 0;
+    for (auto size : profile)
+        if (size > budget) excess += size - budget;
+    return excess;
+}
+
+std::vector<ValueRef> MemoryTimeline::AliveValues(int32_t t) const {
+    // Values alive at a time are stored along the path from its leaf to root
+    std::vector<ValueRef> alive;
+    for (auto n = size_t(t - begin) + nLeaves; n > 0; n >>= 1)
+        for (auto i : nodes[n]) alive.push_back(stat.values[i].value);
+    return alive;
 }
 
-uint32_t OverlapInput(const OpRef &op) {
-    // Cannot handle multiple output op
-    if (op->outputs.size() > 1) return OVERLAP_FAILED;
-    auto &out = op->outputs[0];
+PeakReport ExplainPeaks(const std::vector<OpRef> &sched,
+                        const HierGraph &hier) {
+    auto stat = ComputeLifetime(sched, hier.graph);
+    MemoryTimeline timeline(stat);
+    auto peak = timeline.Peak();
+    auto &profile = timeline.Profile();
 
-    // Check if it is element-wise
-    if (!IsElementWise(op->type) && !IsReinterpret(op->type))
-        return OVERLAP_FAILED;
+    // Maximal usage before and after each time, so the peak after lowering
+    // usage at any one time can be found in constant time
+    auto len = profile.size();
+    std::vector<uint64_t> prefMax(len + 1, 0), sufMax(len + 1, 0);
+    for (auto i = 0u; i < len; i++)
+        prefMax[i + 1] = std::max(prefMax[i], profile[i]);
+    for (auto i = len; i > 0; i--)
+        sufMax[i - 1] = std::max(sufMax[i], profile[i - 1]);
+    auto lastTime = [&](const Lifetime &life) {
+        return std::min(life.kill, timeline.End()) - 1;
+    };
+    auto saving = [&](const Lifetime &life) -> uint64_t {
+        auto t = lastTime(life);
+        if (t < life.gen) return 0;
+        auto i = size_t(t - timeline.Begin());
+        auto lowered = std::max({prefMax[i], sufMax[i + 1],
+                                 profile[i] - life.value->type.Size()});
+        return peak - lowered;
+    };
+
+    // Look up lifetimes of values alive at peak times
+    std::unordered_map<ValueRef, const Lifetime *> valToLife;
+    for (auto &life : stat.values) valToLife.insert({life.value, &life});
+    PeakReport report{peak, {}};
+    for (auto t : timeline.PeakTimes()) {
+        PeakPoint point{t, t >= 0 ? sched[t] : nullptr, {}};
+        for (auto &val : timeline.AliveValues(t)) {
+            auto &life = *valToLife[val];
+            auto def = val->def.lock();
+            SequenceRef seq;
+            if (def) seq = hier.opToSeq.at(def);
+            point.tensors.push_back(
+                {life, def, seq, t - life.gen, saving(life)});
+        }
+        std::sort(point.tensors.begin(), point.tensors.end(),
+                  [](auto &lhs, auto &rhs) {
+                      return lhs.life.value->type.Size() >
+                             rhs.life.value->type.Size();
+                  });
+        report.points.push_back(std::move(point));
+    }
+
+    return report;
+}
+
+void PeakReport::WriteJson(std::ostream &os) const {
+    // Number sequences and groups in order of first appearance
+    std::vector<SequenceRef> seqs;
+    std::unordered_map<SequenceRef, size_t> seqIds;
+    std::unordered_map<GroupRef, size_t> groupIds;
+    for (auto &point : points) {
+        for (auto &tensor : point.tensors) {
+            if (!tensor.seq || Contains(seqIds, tensor.seq)) continue;
+            seqIds.insert({tensor.seq, seqs.size()});
+            seqs.push_back(tensor.seq);
+            auto group = tensor.seq->group.lock();
+            if (group && !Contains(groupIds, group))
+                groupIds.insert({group, groupIds.size()});
+        }
+    }
+    auto fmtName = [](auto &name) { return FmtStr(name, '"'); };
+    auto fmtOpt = [](bool valid, auto fmtVal) {
+        return valid ? fmtVal() : std::string("null");
+    };
+
+    CodeWriter writer(os);
+    writer.WriteLn("{");
+    {
+        auto ind = writer.Indent();
+        writer.WriteLn(fmt::format("\"peak\": {},", peak));
+        writer.WriteLn("\"points\": [");
+        for (auto [i, point] : EnumRange(points)) {
+            auto ind = writer.Indent();
+            writer.WriteLn("{");
+            {
+                auto ind = writer.Indent();
+                writer.WriteLn(fmt::format("\"time\": {},", point.time));
+                writer.WriteLn(fmt::format(
+                    "\"op\": {},", fmtOpt(bool(point.op), [&] {
+                        return fmtName(point.op->name);
+                    })));
+                writer.WriteLn("\"tensors\": [");
+                for (auto [j, tensor] : EnumRange(point.tensors)) {
+                    auto ind = writer.Indent();
+                    auto &life = tensor.life;
+                    auto group = tensor.seq ? tensor.seq->group.lock()
+                                            : GroupRef();
+                    auto line = fmt::format(
+                        "{{\"value\": {}, \"size\": {}, \"op\": {}, "
+                        "\"type\": {}, \"sequence\": {}, \"group\": {}, "
+                        "\"gen\": {}, \"kill\": {}, \"held\": {}, "
+                        "\"saving\": {}}}{}",
+                        fmtName(life.value->name), life.value->type.Size(),
+                        fmtOpt(bool(tensor.def),
+                               [&] { return fmtName(tensor.def->name); }),
+                        fmtOpt(bool(tensor.def),
+                               [&] { return fmtName(tensor.def->type); }),
+                        fmtOpt(bool(tensor.seq),
+                               [&] { return FmtInt(seqIds[tensor.seq]); }),
+                        fmtOpt(bool(group),
+                               [&] { return FmtInt(groupIds[group]); }),
+                        life.gen,
+                        fmtOpt(life.kill != Lifetime::TIME_UNKNOWN,
+                               [&] { return FmtInt(life.kill); }),
+                        tensor.held, tensor.saving,
+                        j + 1 < point.tensors.size() ? "," : "");
+                    writer.WriteLn(line);
+                }
+                writer.WriteLn("]");
+            }
+            writer.WriteLn(i + 1 < points.size() ? "}," : "}");
+        }
+        writer.WriteLn("],");
 
-    // The output value can only overlap the first input value with same size as
-    // it
-    for (auto [i, in] : EnumRange(op->inputs)) {
-        if (in->kind == ValueKind::PARAM) continue;
-        if (in->type.Size() == out->type.Size()) return i;
+        // Ops of sequences referred to by tensors
+        writer.WriteLn("\"sequences\": [");
+        for (auto [i, seq] : EnumRange(seqs)) {
+            auto ind = writer.Indent();
+            writer.WriteLn(fmt::format(
+                "{}{}", FmtList(seq->ops, [&](auto &op) {
+                    return fmtName(op->name);
+                }), i + 1 < seqs.size() ? "," : ""));
+        }
+        writer.WriteLn("]");
     }
+    writer.WriteLn("}");
+}
 
-    return OVERLAP_FAILED;
+void PeakReport::Dump(const std::string &dir, const std::string &name) const {
+    auto path = std::filesystem::path(dir) / (name + ".json");
+    std::ofstream ofs(path);
+    WriteJson(ofs);
 }
 
 LifetimeStat ComputeLifetime(const std::vector<OpRef> &opSeq,
@@ -62,41 +224,68 @@ LifetimeStat ComputeLifetime(const std::vector<OpRef> &opSeq,
         auto &val = in->value;
         valLife.insert(
             {val, Lifetime{val, Lifetime::TIME_INPUT, Lifetime::TIME_UNKNOWN}});
-        useCnt.insert({val, uint32_t(val->uses.size())});
+        useCnt.insert({val, val->MemUseCount()});
     }
 
-    // Compute lifetime
+    // Compute lifetime. Only values owning memory have lifetimes, and uses of
+    // views are counted on their owners.
     for (auto i = 0; i < opSeq.size(); i++) {
         // Initialize lifetime of its outputs
         auto &op = opSeq[i];
         for (auto &out : op->outputs) {
+            if (out->IsView()) continue;
             valLife.insert({out, Lifetime{out, i, Lifetime::TIME_UNKNOWN}});
-            useCnt.insert({out, uint32_t(out->uses.size())});
+            useCnt.insert({out, out->MemUseCount()});
         }
 
+        // Workspace is only alive when this op runs
+        if (op->workspace)
+            valLife.insert({op->workspace, Lifetime{op->workspace, i, i + 1}});
+
         // Compute lifetime ending of its inputs
         auto ovlIdx = OverlapInput(op);
         for (auto j = 0u; j < op->inputs.size(); j++) {
             auto &in = op->inputs[j];
             if (in->kind == ValueKind::PARAM) continue;
-            if (!Contains(useCnt, in))
-                LOG(FATAL) << fmt::format(
-                    "Value {} used without definition before.", in->name);
-            auto &cnt = useCnt[in];
-            cnt--;
-            // If output can overlap this input, its life ends before this op.
-            // Otherwise, it must keep alive until computation of this op is
-            // finished.
-            if (cnt == 0) {
-                valLife[in].kill = ovlIdx == j ? i : i + 1;
-                useCnt.erase(in);
-            }
+            ForEachOwner(in, [&](const ValueRef &owner) {
+                if (!Contains(useCnt, owner))
+                    LOG(FATAL) << fmt::format(
+                        "Value {} used without definition before.", in->name);
+                auto &cnt = useCnt[owner];
+                cnt--;
+                // If output can overlap this input, its life ends before this
+                // op. Otherwise, it must keep alive until computation of this
+                // op is finished.
+                if (cnt == 0) {
+                    valLife[owner].kill = ovlIdx == j ? i : i + 1;
+                    useCnt.erase(owner);
+                }
+            });
         }
     }
 
     // Finalize lifetime of outputs
     int endTime = int32_t(opSeq.size());
-    for (auto &out : graph.outputs) valLife[out->value].kill = endTime;
+    for (auto &out : graph.outputs)
+        ForEachOwner(out->value, [&](const ValueRef &owner) {
+            valLife[owner].kill = endTime;
+        });
+
+    // Owners packed together are alive as long as their block is, from the
+    // first generation to the last kill among them
+    std::unordered_map<ValueRef, std::pair<int32_t, int32_t>> packLife;
+    for (auto &[val, life] : valLife) {
+        auto pack = PackOf(val);
+        if (!pack) continue;
+        auto [it, inserted] = packLife.insert({pack, {life.gen, life.kill}});
+        it->second.first = std::min(it->second.first, life.gen);
+        it->second.second = std::max(it->second.second, life.kill);
+    }
+    if (!packLife.empty())
+        for (auto &[val, life] : valLife) {
+            auto pack = PackOf(val);
+            if (pack) std::tie(life.gen, life.kill) = packLife[pack];
+        }
 
     // Sort lifetime
     auto blocks = Transform<std::vector<Lifetime>>(
@@ -113,52 +302,327 @@ uint64_t EstimatePeak(const std::vector<OpRef> &seq,
     std::unordered_map<ValueRef, uint32_t> useCnt;
     for (auto &inVert : inputs) {
         auto inVal = inVert->value;
-        useCnt.insert({inVal, uint32_t(inVal->uses.size())});
+        useCnt.insert({inVal, inVal->MemUseCount()});
         total += inVal->type.Size();
     }
 
     // Estimate peak at each time
     uint64_t peak = total;
-    std::vector<ValueRef> nextKill;  // values to be killed next time
+    uint64_t nextKill = 0;  // size of values to be killed next time
+    auto isAlive = [&](const ValueRef &val) { return Contains(useCnt, val); };
     for (auto i = 0; i < seq.size(); i++) {
         // Generate outputs
         auto &op = seq[i];
         for (auto &out : op->outputs) {
-            useCnt.insert({out, uint32_t(out->uses.size())});
-            total += out->type.Size();
+            if (out->IsView()) continue;  // views allocate no memory
+            total += PackedSize(out, PackOf(out), isAlive);
+            useCnt.insert({out, out->MemUseCount()});
         }
 
         // Kill values that are left to this time
-        for (auto &val : nextKill) total -= val->type.Size();
-        nextKill.clear();
+        total -= nextKill;
+        nextKill = 0;
 
         // Scan inputs and possibly kill values that are no longer used
         auto ovlIdx = OverlapInput(op);
         for (auto j = 0u; j < op->inputs.size(); j++) {
-            // Update use count of this input value
+            // Update use count of owners of this input value
             auto &in = op->inputs[j];
             if (in->kind == ValueKind::PARAM) continue;
-            if (!Contains(useCnt, in))
-                LOG(FATAL) << fmt::format(
-                    "Value {} used without definition before.", in->name);
-            auto &cnt = useCnt[in];
-            cnt--;
-
-            // Choose time to kill this value
-            if (cnt == 0) {
-                if (ovlIdx == j)  // can overlap, kill this time
-                    total -= in->type.Size();
-                else  // live until end of this op, kill next time
-                    nextKill.push_back(in);
-                useCnt.erase(in);
-            }
+            ForEachOwner(in, [&](const ValueRef &owner) {
+                if (!Contains(useCnt, owner))
+                    LOG(FATAL) << fmt::format(
+                        "Value {} used without definition before.", in->name);
+                auto &cnt = useCnt[owner];
+                cnt--;
+
+                // Choose time to kill this value
+                if (cnt == 0) {
+                    useCnt.erase(owner);
+                    auto size = PackedSize(owner, PackOf(owner), isAlive);
+                    if (ovlIdx == j)  // can overlap, kill this time
+                        total -= size;
+                    else  // live until end of this op, kill next time
+                        nextKill += size;
+                }
+            });
         }
 
-        // Update peak memory
-        peak = std::max(peak, total);
+        // Update peak memory. Workspace is released right after this op.
+        auto ws = op->workspace ? op->workspace->type.Size() : 0;
+        peak = std::max(peak, total + ws);
     }
 
     return peak;
 }
 
-}  // namespace hmcos
\ No newline at end of file
+OpValueIndex::OpValueIndex(const Graph &graph) : ops(graph.ops) {
+    // Index ops
+    auto nOps = ops.size();
+    for (auto [i, op] : EnumRange(ops)) opIds.insert({op, uint32_t(i)});
+
+    // Index values defined by inputs and ops
+    std::unordered_map<ValueRef, uint32_t> valIds;
+    auto addValue = [&](const ValueRef &val, uint32_t def) {
+        auto pack = PackOf(val);
+        auto key = pack ? pack : val;
+        auto [it, inserted] = valIds.insert({key, uint32_t(sizes.size())});
+        valIds.insert({val, it->second});
+        if (inserted) {
+            sizes.push_back(val->IsView() ? 0 : key->type.Size());
+            defs.emplace_back();
+            uses.emplace_back();
+        }
+        if (def != NONE) defs[it->second].push_back(def);
+    };
+    for (auto &input : graph.inputs) {
+        addValue(input->value, NONE);
+        inputSize += input->value->type.Size();
+    }
+    for (auto [i, op] : EnumRange(ops)) {
+        for (auto &val : op->outputs) addValue(val, i);
+        if (op->workspace) addValue(op->workspace, i);
+    }
+
+    // Record dependencies and values of each op
+    preds.resize(nOps);
+    succs.resize(nOps);
+    inputs.resize(nOps);
+    outputs.resize(nOps);
+    overlap.resize(nOps, NONE);
+    for (auto [i, op] : EnumRange(ops)) {
+        for (auto &pred : op->preds) {
+            auto vert = pred.lock();
+            if (Is<Op>(vert)) AddUnique(preds[i], opIds[Cast<Op>(vert)]);
+        }
+        for (auto &succ : op->succs)
+            if (Is<Op>(succ)) AddUnique(succs[i], opIds[Cast<Op>(succ)]);
+        // Uses of views are recorded on their owners
+        for (auto &val : op->inputs) {
+            if (val->kind == ValueKind::PARAM) continue;
+            ForEachOwner(val, [&](const ValueRef &owner) {
+                auto id = valIds[owner];
+                uses[id].push_back(i);
+                AddUnique(inputs[i], id);
+            });
+        }
+        for (auto &val : op->outputs) AddUnique(outputs[i], valIds[val]);
+
+        // Workspace is both defined and used by its op
+        if (op->workspace) {
+            auto id = valIds[op->workspace];
+            uses[id].push_back(i);
+            inputs[i].push_back(id);
+            outputs[i].push_back(id);
+        }
+
+        // The output overlaps an input only if this op is where the input is
+        // killed, which is at the last input referring to its memory
+        auto ovlIdx = OverlapInput(op);
+        if (ovlIdx == OVERLAP_FAILED) continue;
+        auto &ovlVal = op->inputs[ovlIdx];
+        auto refers = [&](const ValueRef &val) {
+            return val == ovlVal || Contains(val->owners, ovlVal);
+        };
+        auto lastIdx = std::find_if(op->inputs.rbegin(), op->inputs.rend(),
+                                    refers) - op->inputs.rbegin();
+        if (op->inputs.size() - 1 - lastIdx == ovlIdx)
+            overlap[i] = valIds[ovlVal];
+    }
+}
+
+/// Number of schedules whose memory changes are accumulated together
+static constexpr size_t BATCH_SIZE = 8;
+
+std::vector<uint64_t> BatchPeakEstimator::Estimate(
+    const std::vector<uint32_t> &scheds) const {
+    auto nOps = index.ops.size();
+    if (nOps == 0) return {};
+    LOG_ASSERT(scheds.size() % nOps == 0);
+    auto nScheds = scheds.size() / nOps;
+
+    // Estimate each batch of schedules in parallel
+    std::vector<uint64_t> peaks(nScheds);
+    auto nBatches = (nScheds + BATCH_SIZE - 1) / BATCH_SIZE;
+    ParallelFor(nBatches, [&](size_t i) {
+        auto begin = i * BATCH_SIZE;
+        estimateBatch(scheds.data() + begin * nOps,
+                      std::min(BATCH_SIZE, nScheds - begin),
+                      peaks.data() + begin);
+    });
+
+    return peaks;
+}
+
+std::vector<uint64_t> BatchPeakEstimator::Estimate(
+    const std::vector<std::vector<OpRef>> &scheds) const {
+    std::vector<uint32_t> mat;
+    mat.reserve(scheds.size() * index.ops.size());
+    for (auto &sched : scheds) {
+        LOG_ASSERT(sched.size() == index.ops.size());
+        for (auto &op : sched) mat.push_back(index.opIds.at(op));
+    }
+    return Estimate(mat);
+}
+
+void BatchPeakEstimator::estimateBatch(const uint32_t *scheds, size_t nScheds,
+                                       uint64_t *peaks) const {
+    // Find first definition and last use time of each value. Values of
+    // different schedules are interleaved, and so are memory changes at each time.
+    auto nOps = index.ops.size(), nVals = index.sizes.size();
+    std::vector<uint32_t> gen(nVals * BATCH_SIZE, 0),
+        last(nVals * BATCH_SIZE, 0);
+    for (auto j = 0u; j < nScheds; j++) {
+        auto row = scheds + j * nOps;
+        for (auto t = nOps; t-- > 0;) {
+            auto op = row[t];
+            for (auto val : index.outputs[op]) gen[val * BATCH_SIZE + j] = t;
+        }
+        for (auto t = 0u; t < nOps; t++) {
+            auto op = row[t];
+            for (auto val : index.inputs[op]) last[val * BATCH_SIZE + j] = t;
+        }
+    }
+
+    // Allocate each value at its definition and free it after its last use,
+    // or right at it if its space is reused by output of that op
+    std::vector<int64_t> delta((nOps + 1) * BATCH_SIZE, 0);
+    for (auto val = 0u; val < nVals; val++) {
+        auto size = int64_t(index.sizes[val]);
+        auto unused = index.uses[val].empty();
+        for (auto j = 0u; j < nScheds; j++) {
+            auto t = last[val * BATCH_SIZE + j];
+            auto kill = unused ? nOps
+                        : index.overlap[scheds[j * nOps + t]] == val ? t
+                                                                     : t + 1;
+            delta[gen[val * BATCH_SIZE + j] * BATCH_SIZE + j] += size;
+            delta[kill * BATCH_SIZE + j] -= size;
+        }
+    }
+
+    // Accumulate memory changes of all schedules together
+    int64_t cur[BATCH_SIZE] = {}, peak[BATCH_SIZE];
+    std::fill(peak, peak + BATCH_SIZE, int64_t(index.inputSize));
+    for (auto t = 0u; t < nOps; t++) {
+        auto tDelta = delta.data() + t * BATCH_SIZE;
+        for (auto j = 0u; j < BATCH_SIZE; j++) {
+            cur[j] += tDelta[j];
+            peak[j] = std::max(peak[j], cur[j]);
+        }
+    }
+    std::copy(peak, peak + nScheds, peaks);
+}
+
+/// Mark ops reachable from `roots` through `next`, whose indices are in open
+/// interval `(lo, hi)`. Marked ops are recorded in `visited`.
+template <class NextFunc>
+static void markReachable(const std::vector<OpRef> &roots, NextFunc next,
+                          int32_t lo, int32_t hi,
+                          const std::unordered_map<OpRef, int32_t> &index,
+                          std::vector<uint32_t> &marks, uint32_t stamp,
+                          std::vector<int32_t> &visited) {
+    std::vector<OpRef> stack(roots);
+    while (!stack.empty()) {
+        auto op = stack.back();
+        stack.pop_back();
+        for (auto &vert : next(op)) {
+            if (!Is<Op>(vert)) continue;
+            auto nextOp = Cast<Op>(vert);
+            auto i = index.at(nextOp);
+            if (i <= lo || i >= hi || marks[i] == stamp) continue;
+            marks[i] = stamp;
+            visited.push_back(i);
+            stack.push_back(nextOp);
+        }
+    }
+}
+
+uint64_t PeakLowerBound(const Graph &graph) {
+    // Index ops in topological order
+    auto ops = ReversePostOrder(graph);
+    auto nOps = int32_t(ops.size());
+    std::unordered_map<OpRef, int32_t> index;
+    for (auto [i, op] : EnumRange(ops)) index.insert({op, int32_t(i)});
+
+    // Count inputs and outputs of each op
+    std::vector<uint64_t> live(nOps, 0);
+    for (auto [i, op] : EnumRange(ops)) {
+        std::vector<ValueRef> counted;
+        for (auto &val : op->inputs) {
+            if (val->kind == ValueKind::PARAM) continue;
+            ForEachOwner(val, [&](const ValueRef &owner) {
+                if (Contains(counted, owner)) return;
+                live[i] += owner->type.Size();
+                counted.push_back(owner);
+            });
+        }
+        for (auto &val : op->outputs)
+            if (!val->IsView()) live[i] += val->type.Size();
+        // Output may reuse space of its input if that input is killed here
+        auto ovlIdx = OverlapInput(op);
+        if (ovlIdx != OVERLAP_FAILED)
+            live[i] -= op->inputs[ovlIdx]->type.Size();
+        if (op->workspace) live[i] += op->workspace->type.Size();
+    }
+
+    // Add values passing over each op. Such an op is a descendant of the
+    // value's definition and an ancestor of one of its uses. Values never
+    // used are alive until the end.
+    auto getSuccs = [](const OpRef &op) { return op->succs; };
+    auto getPreds = [](const OpRef &op) { return op->Preds(); };
+    std::vector<uint32_t> fwdMarks(nOps, 0), bwdMarks(nOps, 0);
+    std::vector<int32_t> fwdVisited, bwdVisited;
+    uint32_t stamp = 0;
+    auto addPassing = [&](const ValueRef &val, const OpRef &def) {
+        std::vector<OpRef> uses;
+        val->ForEachMemUse([&](auto &use) { uses.push_back(use.lock()); });
+        if (!def && uses.empty()) {
+            for (auto &size : live) size += val->type.Size();
+            return;
+        }
+        auto lo = def ? index.at(def) : -1;
+        auto hi = nOps;
+        if (!uses.empty()) {
+            hi = 0;
+            for (auto &use : uses) hi = std::max(hi, index.at(use));
+        }
+        if (hi - lo <= 1) return;
+
+        // Find descendants of definition and ancestors of uses
+        stamp++;
+        fwdVisited.clear();
+        bwdVisited.clear();
+        if (def)
+            markReachable({def}, getSuccs, lo, hi, index, fwdMarks, stamp,
+                          fwdVisited);
+        else
+            for (auto i = lo + 1; i < hi; i++) fwdMarks[i] = stamp;
+        if (uses.empty())
+            for (auto i = lo + 1; i < hi; i++) bwdMarks[i] = stamp;
+        else
+            markReachable(uses, getPreds, lo, hi, index, bwdMarks, stamp,
+                          bwdVisited);
+
+        // Add size to ops in both sets, except those using it
+        auto &visited = def ? fwdVisited : bwdVisited;
+        auto &other = def ? bwdMarks : fwdMarks;
+        for (auto i : visited) {
+            if (other[i] != stamp) continue;
+            if (Contains(uses, ops[i])) continue;
+            live[i] += val->type.Size();
+        }
+    };
+    for (auto &input : graph.inputs) addPassing(input->value, nullptr);
+    for (auto &op : ops)
+        for (auto &val : op->outputs)
+            if (!val->IsView()) addPassing(val, op);
+
+    // Inputs are all alive before any op is executed
+    uint64_t bound = 0;
+    for (auto &input : graph.inputs) bound += input->value->type.Size();
+    for (auto size : live) bound = std::max(bound, size);
+
+    return bound;
+}
+
+}  // namespace hmcos
@@ -0,0 +1,197 @@
+#include <cmath>
+#include <hmcos/sched/life.hpp>
+#include <hmcos/sched/local.hpp>
+#include <hmcos/sched/plan.hpp>
+
+namespace hmcos {
+
+PeakEvaluator::PeakEvaluator(const std::vector<OpRef> &sched,
+                             const Graph &graph)
+    : index(graph), timeline(sched.size()) {
+    LOG_ASSERT(sched.size() == graph.ops.size());
+
+    // Record positions of ops in given schedule
+    order = Transform<std::vector<uint32_t>>(
+        sched, [&](auto &op) { return index.opIds.at(op); });
+    pos.resize(order.size());
+    for (auto [i, id] : EnumRange(order)) pos[id] = i;
+
+    // Build memory timeline
+    std::vector<uint32_t> allVals(index.sizes.size());
+    for (auto i = 0u; i < allVals.size(); i++) allVals[i] = i;
+    updateValues(allVals, 1);
+}
+
+std::vector<OpRef> PeakEvaluator::Schedule() const {
+    return Transform<std::vector<OpRef>>(
+        order, [&](uint32_t id) { return index.ops[id]; });
+}
+
+std::pair<size_t, size_t> PeakEvaluator::MoveRange(size_t i) const {
+    auto id = order[i];
+    size_t lo = 0, hi = order.size() - 1;
+    for (auto pred : index.preds[id]) lo = std::max(lo, size_t(pos[pred]) + 1);
+    for (auto succ : index.succs[id]) hi = std::min(hi, size_t(pos[succ]) - 1);
+    return {lo, hi};
+}
+
+void PeakEvaluator::Swap(size_t i) {
+    // Only lifetimes of values related to these two ops are changed
+    auto first = order[i], second = order[i + 1];
+    LOG_ASSERT(!Contains(index.succs[first], second));
+    std::vector<uint32_t> vals;
+    for (auto id : {first, second}) {
+        for (auto val : index.inputs[id]) AddUnique(vals, val);
+        for (auto val : index.outputs[id]) AddUnique(vals, val);
+    }
+
+    // Swap ops and update their values on timeline
+    updateValues(vals, -1);
+    std::swap(order[i], order[i + 1]);
+    pos[first] = i + 1;
+    pos[second] = i;
+    updateValues(vals, 1);
+}
+
+void PeakEvaluator::Move(size_t from, size_t to) {
+    for (auto i = from; i < to; i++) Swap(i);
+    for (auto i = from; i > to; i--) Swap(i - 1);
+}
+
+std::pair<size_t, size_t> PeakEvaluator::lifetime(uint32_t val) const {
+    // A value is alive since its first definition, or the beginning for
+    // inputs
+    auto nOps = order.size();
+    auto &defs = index.defs[val];
+    size_t gen = defs.empty() ? 0 : nOps;
+    for (auto def : defs) gen = std::min(gen, size_t(pos[def]));
+    if (index.uses[val].empty()) return {gen, nOps};
+
+    // Value is killed after its last use, or right at it if the output of
+    // that op overlaps it
+    size_t last = 0;
+    for (auto use : index.uses[val]) last = std::max(last, size_t(pos[use]));
+    auto kill = index.overlap[order[last]] == val ? last : last + 1;
+    return {gen, kill};
+}
+
+void PeakEvaluator::updateValues(const std::vector<uint32_t> &vals,
+                                 int64_t sign) {
+    for (auto val : vals) {
+        auto [gen, kill] = lifetime(val);
+        timeline.Add(gen, kill, sign * int64_t(index.sizes[val]));
+    }
+}
+
+/// Maximal distance an op is moved in each step of local search
+static constexpr size_t MAX_MOVE_DIST = 16;
+
+std::vector<OpRef> RefineSchedule(const std::vector<OpRef> &sched,
+                                  const Graph &graph, size_t nSteps,
+                                  std::mt19937 &rng) {
+    // Initialize evaluator and best result
+    if (sched.empty()) return sched;
+    PeakEvaluator eval(sched, graph);
+    auto cur = eval.Peak(), best = cur;
+    auto bestSched = sched;
+
+    // Temperature starts at a fraction of peak and linearly decays to zero
+    auto initTemp = double(best) / 100;
+    std::uniform_real_distribution<double> uniform;
+    for (auto step = 0u; step < nSteps; step++) {
+        // Randomly choose an op and where to move it
+        auto from = rng() % sched.size();
+        auto [lo, hi] = eval.MoveRange(from);
+        lo = std::max(lo, from - std::min(from, MAX_MOVE_DIST));
+        hi = std::min(hi, from + MAX_MOVE_DIST);
+        auto to = lo + rng() % (hi - lo + 1);
+        if (to == from) continue;
+
+        // Accept or revert this move
+        eval.Move(from, to);
+        auto peak = eval.Peak();
+        auto temp = initTemp * (1 - double(step) / nSteps);
+        auto accept =
+            peak <= cur ||
+            (temp > 0 && uniform(rng) < std::exp((double(cur) - peak) / temp));
+        if (!accept) {
+            eval.Move(to, from);
+            continue;
+        }
+        cur = peak;
+
+        // Record best schedule
+        if (cur < best) {
+            best = cur;
+            bestSched = eval.Schedule();
+        }
+    }
+
+    return bestSched;
+}
+
+/// Time range spanned by blocks reaching the top of the arena
+static std::pair<int32_t, int32_t> topRange(const MemoryPlan &plan) {
+    auto range = std::make_pair(INT32_MAX, INT32_MIN);
+    for (auto &desc : plan.descs) {
+        if (desc.offset + desc.size != plan.peak) continue;
+        range.first = std::min(range.first, desc.gen);
+        range.second = std::max(range.second, desc.kill);
+    }
+    return range;
+}
+
+std::vector<OpRef> RefineArena(const std::vector<OpRef> &sched,
+                               const Graph &graph, size_t nSteps,
+                               std::mt19937 &rng) {
+    // Plan with a single planner during search, since the portfolio is too
+    // expensive to run at each step
+    if (sched.empty()) return sched;
+    PeakEvaluator eval(sched, graph);
+    auto planOf = [&](const std::vector<OpRef> &sched) {
+        return GreedyBySize(ComputeLifetime(sched, graph));
+    };
+    auto cur = planOf(sched);
+    auto top = topRange(cur);
+    auto curSched = sched;
+
+    for (auto step = 0u; step < nSteps; step++) {
+        // Randomly choose an op and where to move it
+        auto from = rng() % sched.size();
+        auto [lo, hi] = eval.MoveRange(from);
+        lo = std::max(lo, from - std::min(from, MAX_MOVE_DIST));
+        hi = std::min(hi, from + MAX_MOVE_DIST);
+        auto to = lo + rng() % (hi - lo + 1);
+        if (to == from) continue;
+
+        // A move only shifts ops between its ends, so it cannot change
+        // lifetimes of blocks at the top of arena if they are all outside
+        if (int32_t(std::max(from, to)) < top.first ||
+            int32_t(std::min(from, to)) > top.second)
+            continue;
+
+        // Only plan schedules whose peaks may fit in current arena
+        eval.Move(from, to);
+        if (eval.Peak() > cur.peak) {
+            eval.Move(to, from);
+            continue;
+        }
+        auto newSched = eval.Schedule();
+        auto plan = planOf(newSched);
+        if (plan.peak > cur.peak) {
+            eval.Move(to, from);
+            continue;
+        }
+        cur = std::move(plan);
+        top = topRange(cur);
+        curSched = std::move(newSched);
+    }
+
+    // Compare with the given schedule using all planners
+    if (PortfolioPlan(ComputeLifetime(curSched, graph)).peak >
+        PortfolioPlan(ComputeLifetime(sched, graph)).peak)
+        return sched;
+    return curSched;
+}
+
+}  // namespace hmcos
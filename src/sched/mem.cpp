@@ -1,8 +1,128 @@
+#include <hmcos/core/alias.hpp>
 #include <hmcos/sched/life.hpp>
 #include <hmcos/sched/mem.hpp>
 
 namespace hmcos {
 
+MemStateNode::MemStateNode(MemStateNodeRef left, MemStateNodeRef right,
+                           int64_t gap)
+    : left(std::move(left)), right(std::move(right)) {
+    auto &l = this->left, &r = this->right;
+    shift = (l ? l->last : 0) + gap;
+    size = (l ? l->size : 0) + r->size;
+    max = std::max(l ? l->max : INT64_MIN, shift + r->max);
+    last = shift + r->last;
+}
+
+MemStateNode::~MemStateNode() {
+    // Take over children whose last reference is held by a node being
+    // released, so that they are released in this loop
+    std::vector<MemStateNodeRef> stack;
+    for (auto child : {&left, &right})
+        if (*child) stack.push_back(std::move(*child));
+    while (!stack.empty()) {
+        auto node = std::move(stack.back());
+        stack.pop_back();
+        if (node.use_count() != 1) continue;
+        auto &mut = const_cast<MemStateNode &>(*node);
+        for (auto child : {&mut.left, &mut.right})
+            if (*child) stack.push_back(std::move(*child));
+    }
+}
+
+void MemStateVec::Append(uint64_t inc, uint64_t dec) {
+    // Start a new tail if current one is shared with other vectors
+    if (!tail || tail.use_count() != 1) {
+        seal();
+        tail = std::make_shared<MemStateNode>();
+    }
+
+    // States in tail are relative to the end of root
+    auto up = tail->last + int64_t(inc);
+    auto down = up - int64_t(dec);
+    tail->stables.push_back(up);
+    tail->transients.push_back(down);
+    tail->size++;
+    tail->max = std::max(tail->max, up);
+    tail->last = down;
+}
+
+void MemStateVec::Extend(const MemStateVec &other) {
+    if (other.Size() == 0) return;
+    seal();
+    auto otherRoot = other.root;
+    if (other.tail)
+        otherRoot = otherRoot ? std::make_shared<MemStateNode>(otherRoot,
+                                                               other.tail)
+                              : other.tail;
+    root = std::make_shared<MemStateNode>(root, otherRoot, other.init);
+}
+
+std::pair<int64_t, int64_t> MemStateVec::operator[](size_t i) const {
+    LOG_ASSERT(i < Size());
+
+    // Locate the node containing this state
+    auto offset = init;
+    const MemStateNode *node = root.get();
+    if (i >= sizeOf(root)) {
+        i -= sizeOf(root);
+        offset += lastOf(root);
+        node = tail.get();
+    }
+
+    // Descend to the leaf
+    while (node->right) {
+        auto leftSize = sizeOf(node->left);
+        if (i < leftSize)
+            node = node->left.get();
+        else {
+            i -= leftSize;
+            offset += node->shift;
+            node = node->right.get();
+        }
+    }
+
+    return {offset + node->stables[i], offset + node->transients[i]};
+}
+
+void MemStateVec::seal() {
+    if (!tail) return;
+    root = root ? std::make_shared<MemStateNode>(root, tail) : tail;
+    tail.reset();
+}
+
+MemStateIter::MemStateIter(const MemStateVec &vec, size_t index)
+    : index(index) {
+    if (index == vec.Size()) return;
+    auto rootLast = MemStateVec::lastOf(vec.root);
+    if (vec.tail) pending.push_back({vec.tail.get(), vec.init + rootLast});
+    if (vec.root) pending.push_back({vec.root.get(), vec.init});
+    nextLeaf();
+}
+
+void MemStateIter::operator++() {
+    index++;
+    if (++leafIdx < leaf->size) return;
+    if (!pending.empty()) nextLeaf();
+}
+
+void MemStateIter::nextLeaf() {
+    while (!pending.empty()) {
+        auto [node, nodeOffset] = pending.back();
+        pending.pop_back();
+        if (node->size == 0) continue;
+        if (node->right) {
+            pending.push_back({node->right.get(), nodeOffset + node->shift});
+            if (node->left) pending.push_back({node->left.get(), nodeOffset});
+            continue;
+        }
+        leaf = node;
+        offset = nodeOffset;
+        leafIdx = 0;
+        return;
+    }
+}
+
 std::pair<uint64_t, uint64_t> ComputeIncDec(
     const OpRef &op, const std::vector<ValueRef> &killed) {
     // See if output value can overlap one of the input
@@ -10,21 +130,38 @@ std::pair<uint64_t, uint64_t> ComputeIncDec(
     if (ovlIdx != OVERLAP_FAILED && !Contains(killed, op->inputs[ovlIdx]))
         ovlIdx = OVERLAP_FAILED;
 
-    // Compute increase in size at transition to transient state
+    // Compute increase in size at transition to transient state. Views
+    // allocate no memory. Packed owners are taken as generated in order of the
+    // pack, so the block is allocated with the first one.
     uint64_t inc = 0;
     if (ovlIdx == OVERLAP_FAILED)
-        inc = std::transform_reduce(op->outputs.begin(), op->outputs.end(),
-                                    0ull, std::plus(),
-                                    [](auto &val) { return val->type.Size(); });
+        for (auto &val : op->outputs) {
+            if (val->IsView()) continue;
+            auto pack = PackOf(val);
+            if (!pack)
+                inc += val->type.Size();
+            else if (val == pack->owners.front())
+                inc += pack->type.Size();
+        }
 
-    // Compute decrease in size at transition to stable state
+    // Compute decrease in size at transition to stable state. Killed values
+    // are owners of memory referred to by inputs.
     auto ovlVal = ovlIdx == OVERLAP_FAILED ? nullptr : op->inputs[ovlIdx];
     auto dec = 0ull;
-    for (auto &val : op->inputs) {
-        if (val->kind == ValueKind::PARAM) continue;  // skip parameters
-        if (!Contains(killed, val)) continue;         // value is not killed
+    for (auto &val : killed) {
         if (val == ovlVal) continue;  // overlapped value should not be counted
-        dec += val->type.Size();
+        auto pack = PackOf(val);
+        if (!pack)
+            dec += val->type.Size();
+        else if (val == pack->owners.back())
+            dec += pack->type.Size();  // block is freed with the last one
+    }
+
+    // Workspace is allocated in transient state and released in stable state
+    if (op->workspace) {
+        auto ws = op->workspace->type.Size();
+        inc += ws;
+        dec += ws;
     }
 
     return {inc, dec};
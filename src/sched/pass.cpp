@@ -1,7 +1,7 @@
+#include <hmcos/core/alias.hpp>
 #include <hmcos/sched/mem.hpp>
 #include <hmcos/sched/pass.hpp>
 #include <hmcos/util/fmt.hpp>
-#include <hmcos/util/op.hpp>
 
 namespace hmcos {
 
@@ -10,13 +10,21 @@ public:
     JoinVisitor(HierGraph &hier) : hier(hier) {}
 
     void Join() {
-        for (auto &in : hier.inputs) Visit(in);
+        // Traverse in depth-first order with an explicit stack. Each sequence
+        // is joined with its successors before they are pushed.
+        std::vector<HierVertRef> stack(hier.inputs.rbegin(),
+                                       hier.inputs.rend());
+        while (!stack.empty()) {
+            auto vert = stack.back();
+            stack.pop_back();
+            if (Contains(memo, vert)) continue;
+            Visit(vert);
+            for (auto it = vert->succs.rbegin(); it != vert->succs.rend(); it++)
+                stack.push_back(*it);
+        }
     }
 
-    Unit VisitInput(const HierInputRef &input) override {
-        for (auto &succ : input->succs) Visit(succ);
-        return {};
-    }
+    Unit VisitInput(const HierInputRef &input) override { return {}; }
 
     Unit VisitOutput(const HierOutputRef &output) override { return {}; }
 
@@ -39,13 +47,13 @@ public:
             // Try join if next op is not element-wise
             auto [inc, dec] = computeIncDec(next->ops[0]);
             auto [s, t] = states.ComputeState(inc, dec);
-            if (s > states.Stables().Max() || t > states.Latest())
+            if (s > states.Peak() || t > states.Latest())
                 break;  // incurs higher footprint, stop here
             states.Append(inc, dec);
             join(cur, next);
         }
 
-        return visitSuccs(seq);
+        return {};
     }
 
     Unit VisitGroup(const GroupRef &group) override {
@@ -55,17 +63,17 @@ public:
     }
 
 private:
-    Unit visitSuccs(const SequenceRef &seq) {
-        for (auto &succ : seq->succs) Visit(succ);
-        return {};
-    }
-
     static std::pair<uint64_t, uint64_t> computeIncDec(const OpRef &op) {
         std::vector<ValueRef> killed;
-        for (auto &in : op->inputs)
-            if (std::all_of(in->uses.begin(), in->uses.end(),
-                            [&](auto &use) { return use.lock() == op; }))
-                AddUnique(killed, in);
+        for (auto &in : op->inputs) {
+            if (in->kind == ValueKind::PARAM) continue;
+            ForEachOwner(in, [&](const ValueRef &owner) {
+                auto onlyThis = true;
+                owner->ForEachMemUse(
+                    [&](auto &use) { onlyThis &= use.lock() == op; });
+                if (onlyThis) AddUnique(killed, owner);
+            });
+        }
         return ComputeIncDec(op, killed);
     }
 
@@ -77,6 +85,8 @@ private:
             prev->ops.push_back(op);
             hier.opToSeq[op] = prev;
         }
+        prev->mems.insert(prev->mems.end(), next->mems.begin(),
+                          next->mems.end());
         prev->outputs = next->outputs;
 
         // Reconnect vertices
@@ -87,7 +97,82 @@ private:
     HierGraph &hier;
 };
 
-void JoinSequencePass::Run(HierGraph &hier) { JoinVisitor(hier).Join(); }
+/// Prepend each sequence whose output is fused to the sequence using it, so
+/// that fused ops are always scheduled back to back. A fused value is the only
+/// output of the last op of its sequence, and is the only non-parameter input
+/// of the first op of another sequence, which is thus the only successor. The
+/// joined sequence therefore still meets the contract of `Sequence`.
+static void joinFused(HierGraph &hier) {
+    for (auto &prod : hier.graph.ops) {
+        if (prod->outputs.size() != 1 || !prod->outputs[0]->fused) continue;
+        auto prev = hier.opToSeq.at(prod);
+        auto next = hier.opToSeq.at(prod->outputs[0]->uses[0].lock());
+        if (prev == next) continue;
+        LOG_ASSERT(prev->succs.size() == 1 && prev->succs[0] == next);
+
+        // Modify sequence data
+        for (auto &op : prev->ops) hier.opToSeq[op] = next;
+        next->ops.insert(next->ops.begin(), prev->ops.begin(), prev->ops.end());
+        next->mems.insert(next->mems.begin(), prev->mems.begin(),
+                          prev->mems.end());
+        Remove(next->inputs, prod->outputs[0]);
+        for (auto &val : prev->inputs) AddUnique(next->inputs, val);
+
+        // Reconnect vertices
+        HierVertex::Disconnect(prev, next);
+        for (auto &pred : prev->Preds()) {
+            HierVertex::ReplaceSuccOfPred(pred, prev, next);
+            AddUnique(next->preds, HierVertWeakRef(pred));
+        }
+    }
+}
+
+void JoinSequencePass::Run(HierGraph &hier) {
+    JoinVisitor(hier).Join();
+    joinFused(hier);
+}
+
+std::function<bool(const OpRef &, const OpRef &)> FuseOpsPass::canFuse =
+    [](auto &, auto &consumer) { return consumer->Traits().fusible; };
+
+void FuseOpsPass::Run(HierGraph &hier) {
+    std::unordered_set<ValueRef> outVals;
+    for (auto &out : hier.outputs) outVals.insert(out->value);
+
+    // Mark values between fusible ops. Ops are visited in topological order,
+    // so owners of inputs of a chain are always found through fused values.
+    for (auto &prod : hier.graph.ops) {
+        if (hier.opToSeq.at(prod)->group.lock())
+            LOG(FATAL) << "Cannot run `FuseOpsPass` on a hierarchical graph "
+                          "with groups.";
+        if (prod->outputs.size() != 1) continue;
+        auto &val = prod->outputs[0];
+        if (val->IsView() || !val->views.empty() || Contains(outVals, val))
+            continue;
+        if (val->uses.size() != 1) continue;
+
+        // A consumer is joined after its producer in one sequence, so it can
+        // only read the fused value besides parameters. This also keeps it
+        // from being fused into another producer.
+        auto cons = val->uses[0].lock();
+        if (std::any_of(cons->inputs.begin(), cons->inputs.end(),
+                        [&](auto &in) {
+                            return in->kind != ValueKind::PARAM && in != val;
+                        }))
+            continue;
+        if (!canFuse(prod, cons)) continue;
+        AddFused(val);
+    }
+
+    // Keep fused ops together, and update their memory behaviors
+    joinFused(hier);
+    std::unordered_set<SequenceRef> seqs;
+    for (auto &[op, seq] : hier.opToSeq) {
+        if (!seqs.insert(seq).second) continue;
+        for (auto [op, mem] : ZipRange(seq->ops, seq->mems))
+            mem = OpMemInfo(op);
+    }
+}
 
 using HierListFunc =
     std::function<std::vector<HierVertRef>(const HierVertRef &)>;
@@ -105,6 +190,11 @@ public:
           frontier(frontier),
           sink(sink) {}
 
+    std::vector<HierVertRef> Deps(const HierVertRef &vert) override {
+        if (!Is<Sequence>(vert) || !inSet(Cast<Sequence>(vert))) return {};
+        return getSuccs(vert);
+    }
+
     bool VisitSequence(const SequenceRef &seq) override {
         if (!inSet(seq)) return false;
         set.insert(seq);
@@ -115,8 +205,9 @@ public:
             isFrontier |= notIn;
             isSink &= notIn;
         }
-        if (isFrontier) AddUnique(frontier, seq);
-        if (isSink) AddUnique(sink, seq);
+        // Each sequence is visited only once, so no need to check uniqueness
+        if (isFrontier) frontier.push_back(seq);
+        if (isSink) sink.push_back(seq);
         return true;
     }
 
@@ -142,16 +233,19 @@ inline static void initOrInc(std::unordered_map<ValueRef, uint32_t> &map,
 
 static std::vector<std::pair<ValueRef, uint32_t>> countConsumed(
     const std::unordered_set<SequenceRef> &set,
-    const std::vector<SequenceRef> &inFront) {
-    // Find all values consumed by input frontiers
+    const std::unordered_set<OpRef> &ops) {
+    // Find all owners defined outside and consumed by ops in the set. A view
+    // consumes its owners, which may be defined far from the frontiers.
     std::unordered_map<ValueRef, uint32_t> consumed;
-    for (auto &seq : inFront) {
-        for (auto &in : seq->inputs) {
-            auto def = in->def.lock();
-            if (std::any_of(set.begin(), set.end(),
-                            [&](auto &seq) { return seq->Contains(def); }))
-                continue;
-            initOrInc(consumed, in);
+    for (auto &seq : set) {
+        for (auto &op : seq->ops) {
+            for (auto &in : op->inputs) {
+                if (in->kind == ValueKind::PARAM) continue;
+                ForEachOwner(in, [&](const ValueRef &owner) {
+                    if (!Contains(ops, owner->def.lock()))
+                        initOrInc(consumed, owner);
+                });
+            }
         }
     }
 
@@ -160,17 +254,21 @@ static std::vector<std::pair<ValueRef, uint32_t>> countConsumed(
 
 static std::vector<std::pair<ValueRef, uint32_t>> countProduced(
     const std::unordered_set<SequenceRef> &set,
-    const std::vector<SequenceRef> &outFront) {
-    // Find all values produced by output frontiers
+    const std::unordered_set<OpRef> &ops) {
+    // Find all owners produced by ops in the set, and remove count of uses in
+    // the set
     std::unordered_map<ValueRef, uint32_t> produced;
-    for (auto &seq : outFront)
-        for (auto &out : seq->outputs)
-            produced.insert({out, uint32_t(out->uses.size())});
-
-    // Remove count of those consumed by sequences in the set
-    for (auto &seq : set)
-        for (auto &in : seq->inputs)
-            if (Contains(produced, in)) produced[in]--;
+    for (auto &seq : set) {
+        for (auto &op : seq->ops) {
+            for (auto &out : op->outputs) {
+                if (out->IsView()) continue;
+                uint32_t cnt = 0;
+                out->ForEachMemUse(
+                    [&](auto &use) { cnt += !Contains(ops, use.lock()); });
+                produced.insert({out, cnt});
+            }
+        }
+    }
 
     // Prune pairs whose count is zero
     std::vector<std::pair<ValueRef, uint32_t>> vec;
@@ -195,8 +293,10 @@ static GroupRef createGroup(const std::unordered_set<SequenceRef> &set,
     group->seqs = std::vector(set.begin(), set.end());
     group->inFront = inFront;
     group->outFront = outFront;
-    group->consumed = countConsumed(set, inFront);
-    group->produced = countProduced(set, outFront);
+    std::unordered_set<OpRef> ops;
+    for (auto &seq : set) ops.insert(seq->ops.begin(), seq->ops.end());
+    group->consumed = countConsumed(set, ops);
+    group->produced = countProduced(set, ops);
     group->entrs = entrs;
     group->exits = exits;
 
@@ -234,6 +334,26 @@ static GroupRef createGroup(const std::unordered_set<SequenceRef> &set,
     return group;
 }
 
+GroupRef GroupSequences(const std::unordered_set<SequenceRef> &seqs) {
+    // Classify sequences by whether their neighbors are in the set
+    auto inSet = [&](const HierVertRef &vert) {
+        return Is<Sequence>(vert) && Contains(seqs, Cast<Sequence>(vert));
+    };
+    std::vector<SequenceRef> inFront, outFront, entrs, exits;
+    for (auto &seq : seqs) {
+        auto preds = seq->Preds();
+        auto nPredIn = size_t(std::count_if(preds.begin(), preds.end(), inSet));
+        if (nPredIn < preds.size()) inFront.push_back(seq);
+        if (nPredIn == 0) entrs.push_back(seq);
+        auto nSuccIn = size_t(
+            std::count_if(seq->succs.begin(), seq->succs.end(), inSet));
+        if (nSuccIn < seq->succs.size()) outFront.push_back(seq);
+        if (nSuccIn == 0) exits.push_back(seq);
+    }
+
+    return createGroup(seqs, inFront, outFront, entrs, exits);
+}
+
 /// Use DP to find a subset of intruded sequences which minimize size of its
 /// outputs.
 class OutputSizeOptimizer {
@@ -345,6 +465,36 @@ inline static void makeGroupFromCell(const SequenceRef &cellOut) {
         std::mem_fn(&HierVertex::Preds), seqs, cellInFront, cellEntrs)
         .Visit(cellOut);
 
+    // A sequence post-dominated by the cell output may still have successors
+    // outside the cell, such as cells grouped before. Remove it along with its
+    // ancestors in the cell, so that no path leaves the cell and enters again.
+    std::vector<SequenceRef> stack;
+    for (auto &seq : seqs) {
+        if (seq == cellOut) continue;
+        if (!std::all_of(seq->succs.begin(), seq->succs.end(), [&](auto &succ) {
+                return Is<Sequence>(succ) &&
+                       Contains(seqs, Cast<Sequence>(succ));
+            }))
+            stack.push_back(seq);
+    }
+    if (!stack.empty()) {
+        auto closed = seqs;
+        while (!stack.empty()) {
+            auto seq = stack.back();
+            stack.pop_back();
+            if (closed.erase(seq) == 0) continue;
+            for (auto &pred : seq->Preds())
+                if (Is<Sequence>(pred)) stack.push_back(Cast<Sequence>(pred));
+        }
+        seqs.clear();
+        cellInFront.clear();
+        cellEntrs.clear();
+        SequenceDetector(
+            [&](const SequenceRef &seq) { return Contains(closed, seq); },
+            std::mem_fn(&HierVertex::Preds), seqs, cellInFront, cellEntrs)
+            .Visit(cellOut);
+    }
+
     // Detect output frontier of the group by intruding on other cells
     std::unordered_set<SequenceRef> intruded;
     std::vector<SequenceRef> intrOutFront, intrExits;
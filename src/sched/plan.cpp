@@ -1,7 +1,12 @@
+#include <chrono>
 #include <filesystem>
 #include <fstream>
+#include <hmcos/core/alias.hpp>
 #include <hmcos/sched/plan.hpp>
+#include <hmcos/util/parallel.hpp>
+#include <hmcos/util/vec.hpp>
 #include <hmcos/util/viz.hpp>
+#include <numeric>
 
 namespace hmcos {
 
@@ -13,8 +18,8 @@ uint64_t Container::Place(int32_t begin, int32_t width, uint64_t height) {
                                   tEnd - width, begin);
         return false;
     }
-    auto idx = findStepAt(begin);
-    auto step = steps[idx];
+    auto it = findStepAt(begin);
+    auto step = it->second;
 
     // Check if the item can be placed at this step
     if (end > step.End()) {
@@ -29,18 +34,17 @@ uint64_t Container::Place(int32_t begin, int32_t width, uint64_t height) {
     maxHeight = std::max(maxHeight, newHeight);
 
     // Place this item by modifying current steps
-    steps.erase(steps.begin() + idx);
-    std::vector<Step> inserted;
+    eraseStep(it);
     if (begin != step.begin)  // gap on left fringe
-        inserted.push_back({step.begin, begin - step.begin, step.offset});
-    inserted.push_back({begin, width, newHeight});
+        insertStep({step.begin, begin - step.begin, step.offset});
+    auto placed = insertStep({begin, width, newHeight});
     if (end != step.End())  // gap on right fringe
-        inserted.push_back({end, step.End() - end, step.offset});
-    steps.insert(steps.begin() + idx, inserted.begin(), inserted.end());
+        insertStep({end, step.End() - end, step.offset});
 
-    /// Merge steps that have same offsets to one step
-    auto beginIdx = std::max(idx - 1, 0);
-    tryMerge(beginIdx, uint32_t(inserted.size() + 1));
+    /// Merge steps that have same offsets to one step. Fringes have offsets
+    /// different from their outer neighbors, so only the placed step can be
+    /// merged.
+    tryMerge(placed);
 
     return step.offset;
 }
@@ -53,71 +57,160 @@ void Container::Lift(int32_t time) {
     }
 
     // Find step
-    auto idx = findStepAt(time);
-    auto &step = steps[idx];
+    auto it = findStepAt(time);
+    auto &step = it->second;
 
-    // Lift step to its lowest neighbor
-    if (idx == 0) {
-        auto &rightStep = steps[1];
+    // Find offset of its lowest neighbor
+    uint64_t newOffset;
+    if (it == steps.begin()) {
+        auto &rightStep = std::next(it)->second;
         if (step.offset > rightStep.offset) {
             LOG(ERROR) << fmt::format("Step {} is higher than step {}.",
                                       step.Format(), rightStep.Format());
             return;
         }
-        step.offset = rightStep.offset;
-        tryMerge(idx, 1);
-    } else if (idx == int32_t(steps.size()) - 1) {
-        auto &leftStep = steps[idx - 1];
+        newOffset = rightStep.offset;
+    } else if (std::next(it) == steps.end()) {
+        auto &leftStep = std::prev(it)->second;
         if (step.offset > leftStep.offset) {
             LOG(ERROR) << fmt::format("Step {} is higher than step {}.",
                                       step.Format(), leftStep.Format());
             return;
         }
-        step.offset = leftStep.offset;
-        tryMerge(idx - 1, 1);
+        newOffset = leftStep.offset;
     } else {
-        auto &leftStep = steps[idx - 1], &rightStep = steps[idx + 1];
+        auto &leftStep = std::prev(it)->second,
+             &rightStep = std::next(it)->second;
         if (step.offset > leftStep.offset || step.offset > rightStep.offset) {
             LOG(ERROR) << fmt::format(
                 "Step {} is higher than step {} or step {}.", step.Format(),
                 leftStep.Format(), rightStep.Format());
             return;
         }
-        step.offset = std::min(leftStep.offset, rightStep.offset);
-        tryMerge(idx - 1, 2);
+        newOffset = std::min(leftStep.offset, rightStep.offset);
     }
+
+    // Lift step to its lowest neighbor
+    byOffset.erase({step.offset, step.begin});
+    step.offset = newOffset;
+    byOffset.insert({step.offset, step.begin});
+    tryMerge(it);
 }
 
-inline int32_t Container::findStepAt(int32_t time) const {
+Container::StepIter Container::findStepAt(int32_t time) {
     LOG_ASSERT(time >= tBegin && time < tEnd);
-    auto next = std::upper_bound(steps.begin(), steps.end(), Step{time, 0, 0},
-                                 CmpByBegin);
-    return int32_t(next - steps.begin()) - 1;
+    return std::prev(steps.upper_bound(time));
 }
 
-void Container::tryMerge(size_t beginIdx, uint32_t nTrial) {
-    auto stepIdx = beginIdx;
-    for (auto i = 0u; i < nTrial; i++) {
-        // No steps behind, cannot merge further
-        if (stepIdx == steps.size() - 1) return;
+Container::StepIter Container::insertStep(const Step &step) {
+    byOffset.insert({step.offset, step.begin});
+    return steps.insert({step.begin, step}).first;
+}
+
+void Container::eraseStep(StepIter it) {
+    byOffset.erase({it->second.offset, it->first});
+    steps.erase(it);
+}
 
-        // Merge two steps if they have same offsets
-        auto curStep = &steps[stepIdx], nextStep = &steps[stepIdx + 1];
-        if (curStep->offset == nextStep->offset) {
-            curStep->width += nextStep->width;
-            steps.erase(steps.begin() + stepIdx + 1);
-        } else
-            stepIdx++;
+void Container::tryMerge(StepIter it) {
+    // Merge with previous step. Key of the previous step is unchanged.
+    if (it != steps.begin()) {
+        auto prev = std::prev(it);
+        if (prev->second.offset == it->second.offset) {
+            prev->second.width += it->second.width;
+            eraseStep(it);
+            it = prev;
+        }
+    }
+
+    // Merge with next step
+    auto next = std::next(it);
+    if (next != steps.end() && next->second.offset == it->second.offset) {
+        it->second.width += next->second.width;
+        eraseStep(next);
     }
 }
 
+IntervalTree::IntervalTree(int32_t begin, int32_t end) : begin(begin) {
+    while (nLeaves < size_t(end - begin)) nLeaves <<= 1;
+    full.resize(2 * nLeaves);
+    partial.resize(2 * nLeaves);
+    nodeStamps.resize(2 * nLeaves, 0);
+}
+
+template <class F>
+void IntervalTree::forCanonical(int32_t gen, int32_t kill, F f) const {
+    auto l = size_t(gen - begin) + nLeaves, r = size_t(kill - begin) + nLeaves;
+    for (; l < r; l >>= 1, r >>= 1) {
+        if (l & 1) f(l++);
+        if (r & 1) f(--r);
+    }
+}
+
+void IntervalTree::Insert(int32_t gen, int32_t kill, uint32_t id) {
+    if (idStamps.size() <= id) idStamps.resize(id + 1, 0);
+    curStamp++;
+    forCanonical(gen, kill, [&](size_t node) {
+        full[node].push_back(id);
+        // Ancestors are only partially covered
+        for (node >>= 1; node > 0 && nodeStamps[node] != curStamp;
+             node >>= 1) {
+            nodeStamps[node] = curStamp;
+            partial[node].push_back(id);
+        }
+    });
+}
+
+void IntervalTree::Query(int32_t gen, int32_t kill,
+                         std::vector<uint32_t> &ids) {
+    curStamp++;
+    auto add = [&](const std::vector<uint32_t> &list) {
+        for (auto id : list) {
+            if (idStamps[id] == curStamp) continue;
+            idStamps[id] = curStamp;
+            ids.push_back(id);
+        }
+    };
+    forCanonical(gen, kill, [&](size_t node) {
+        // Lifetimes in the subtree of a canonical node all overlap the query
+        add(full[node]);
+        add(partial[node]);
+        // Lifetimes fully covering ancestors also cover this node
+        for (node >>= 1; node > 0 && nodeStamps[node] != curStamp;
+             node >>= 1) {
+            nodeStamps[node] = curStamp;
+            add(full[node]);
+        }
+    });
+}
+
 MemoryPlan::MemoryPlan(uint64_t peak, std::vector<MemoryDesc> &&descs)
     : peak(peak), descs(std::move(descs)) {
     // Sort memory descriptors according to lifetime
     std::sort(this->descs.begin(), this->descs.end(), CmpByGenKill);
 
-    // Map values to offsets
-    for (auto &desc : descs) valToOff.insert({desc.value, desc.offset});
+    // Map values to offsets. A block of a view packs its owners, each at the
+    // negated offset of it in the view.
+    for (auto &desc : this->descs) {
+        valToOff.insert({desc.value, desc.offset});
+        for (auto &[base, offset] : desc.value->bases)
+            valToOff.insert({base, desc.offset - offset});
+    }
+
+    // Resolve addresses of other views from their first bases. Views of an
+    // owner are stored in topological order, so their bases are resolved
+    // before them. Fused values have no address.
+    for (auto &desc : this->descs) {
+        for (auto &owner : desc.value->IsView() ? desc.value->owners
+                                                : std::vector{desc.value}) {
+            for (auto &weak : owner->views) {
+                auto view = weak.lock();
+                if (view->fused || Contains(valToOff, view)) continue;
+                auto &[base, offset] = view->bases.front();
+                valToOff.insert({view, valToOff.at(base) + offset});
+            }
+        }
+    }
 }
 
 void MemoryPlan::Print() const {
@@ -146,37 +239,321 @@ void MemoryPlan::Plot(const std::string &dir, const std::string &name,
     plot.Render(dir, format);
 }
 
+static uint64_t alignUp(uint64_t offset, uint64_t alignment) {
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+/// Create memory descriptors of values, and clamp lifetimes of values never
+/// killed to the end of the lifetime range
+static std::vector<MemoryDesc> createDescs(const LifetimeStat &stat) {
+    // Owners packed by a view must be contiguous, so they are placed as one
+    // block of that view, alive from the first generation to the last kill
+    std::vector<MemoryDesc> descs;
+    std::unordered_map<ValueRef, size_t> packIdx;
+    for (auto &life : stat.values) {
+        auto pack = PackOf(life.value);
+        if (!pack) {
+            descs.emplace_back(life);
+            continue;
+        }
+        auto [it, inserted] = packIdx.insert({pack, descs.size()});
+        if (inserted) {
+            descs.emplace_back(Lifetime{pack, life.gen, life.kill});
+            continue;
+        }
+        auto &desc = descs[it->second];
+        desc.gen = std::min(desc.gen, life.gen);
+        desc.kill = std::max(desc.kill, life.kill);
+    }
+    for (auto &desc : descs) desc.kill = std::min(desc.kill, stat.range.second);
+    return descs;
+}
+
+/// Unplaced memory blocks indexed by lifetimes, for finding the best fit
+/// within a time range. Blocks are ordered by beginning time in a segment
+/// tree. Each node keeps its blocks ordered by end time, along with a tree of
+/// best blocks over them.
+class UnplacedIndex {
+public:
+    static constexpr auto NONE = UINT32_MAX;
+
+    UnplacedIndex(const std::vector<MemoryDesc> &descs);
+
+    /// Find the best unplaced block whose lifetime is within [begin, end).
+    uint32_t BestFit(int32_t begin, int32_t end) const;
+
+    /// Remove a block from the index
+    void Remove(uint32_t idx);
+
+private:
+    struct Node {
+        /// Indices of blocks sorted by end time
+        std::vector<uint32_t> blocks;
+        /// Best of ranges of `blocks`, as in an iterative segment tree
+        std::vector<uint32_t> best;
+    };
+
+    /// Longer lifetime fits better. For blocks with same lifetime, the one
+    /// with lower index is preferred.
+    uint32_t better(uint32_t lhs, uint32_t rhs) const {
+        if (lhs == NONE) return rhs;
+        if (rhs == NONE) return lhs;
+        if (CmpByLengthInv(descs[rhs], descs[lhs])) return rhs;
+        if (CmpByLengthInv(descs[lhs], descs[rhs])) return lhs;
+        return std::min(lhs, rhs);
+    }
+
+    bool cmpByKill(uint32_t lhs, uint32_t rhs) const {
+        auto lk = descs[lhs].kill, rk = descs[rhs].kill;
+        return lk != rk ? lk < rk : lhs < rhs;
+    }
+
+    const std::vector<MemoryDesc> &descs;
+    /// Beginning times of blocks in sorted order
+    std::vector<int32_t> gens;
+    /// Leaf position of each block
+    std::vector<uint32_t> leafPos;
+    size_t nLeaves = 1;
+    std::vector<Node> nodes;
+};
+
+UnplacedIndex::UnplacedIndex(const std::vector<MemoryDesc> &descs)
+    : descs(descs) {
+    // Sort blocks by beginning time
+    std::vector<uint32_t> byGen(descs.size());
+    std::iota(byGen.begin(), byGen.end(), 0);
+    std::stable_sort(byGen.begin(), byGen.end(), [&](auto lhs, auto rhs) {
+        return descs[lhs].gen < descs[rhs].gen;
+    });
+    gens = Transform<std::vector<int32_t>>(
+        byGen, [&](auto idx) { return descs[idx].gen; });
+    leafPos.resize(descs.size());
+    for (auto [pos, idx] : EnumRange(byGen)) leafPos[idx] = uint32_t(pos);
+
+    // Build nodes by merging blocks of children
+    while (nLeaves < descs.size()) nLeaves <<= 1;
+    nodes.resize(2 * nLeaves);
+    auto cmp = [this](auto lhs, auto rhs) { return cmpByKill(lhs, rhs); };
+    for (auto [pos, idx] : EnumRange(byGen))
+        nodes[nLeaves + pos].blocks.push_back(idx);
+    for (auto n = nLeaves - 1; n > 0; n--) {
+        auto &lhs = nodes[2 * n].blocks, &rhs = nodes[2 * n + 1].blocks;
+        auto &blocks = nodes[n].blocks;
+        std::merge(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                   std::back_inserter(blocks), cmp);
+    }
+    for (auto &node : nodes) {
+        auto size = node.blocks.size();
+        node.best.resize(2 * size);
+        std::copy(node.blocks.begin(), node.blocks.end(),
+                  node.best.begin() + size);
+        for (auto i = size; i-- > 1;)
+            node.best[i] = better(node.best[2 * i], node.best[2 * i + 1]);
+    }
+}
+
+uint32_t UnplacedIndex::BestFit(int32_t begin, int32_t end) const {
+    // Query nodes covering blocks beginning no earlier than `begin`
+    auto result = NONE;
+    auto first = std::lower_bound(gens.begin(), gens.end(), begin);
+    auto l = size_t(first - gens.begin()) + nLeaves, r = 2 * nLeaves;
+    auto queryNode = [&](const Node &node) {
+        // Blocks in this node ending no later than `end` form a prefix
+        auto last = std::partition_point(
+            node.blocks.begin(), node.blocks.end(),
+            [&](auto idx) { return descs[idx].kill <= end; });
+        auto cnt = size_t(last - node.blocks.begin());
+        auto size = node.blocks.size();
+        for (auto i = size, j = size + cnt; i < j; i >>= 1, j >>= 1) {
+            if (i & 1) result = better(result, node.best[i++]);
+            if (j & 1) result = better(result, node.best[--j]);
+        }
+    };
+    for (; l < r; l >>= 1, r >>= 1) {
+        if (l & 1) queryNode(nodes[l++]);
+        if (r & 1) queryNode(nodes[--r]);
+    }
+    return result;
+}
+
+void UnplacedIndex::Remove(uint32_t idx) {
+    for (auto n = leafPos[idx] + nLeaves; n > 0; n >>= 1) {
+        auto &node = nodes[n];
+        auto it = std::lower_bound(
+            node.blocks.begin(), node.blocks.end(), idx,
+            [this](auto lhs, auto rhs) { return cmpByKill(lhs, rhs); });
+        auto i = size_t(it - node.blocks.begin()) + node.blocks.size();
+        node.best[i] = NONE;
+        for (i >>= 1; i > 0; i >>= 1)
+            node.best[i] = better(node.best[2 * i], node.best[2 * i + 1]);
+    }
+}
+
 MemoryPlan BestFit(const LifetimeStat &stat) {
     // Initialize unplaced memory descriptors and container
-    auto unplaced = Transform<std::vector<MemoryDesc>>(
-        stat.values, [](auto &lt) { return MemoryDesc(lt); });
+    auto unplaced = createDescs(stat);
+    auto align = AlignPolicy::Get().MaxAlignment();
+    for (auto &desc : unplaced)
+        desc.size = alignUp(desc.size, align);
+    UnplacedIndex index(unplaced);
     Container cont(stat.range.first, stat.range.second);
 
     // Iterate until no blocks remain
     std::vector<MemoryDesc> placed;
-    while (!unplaced.empty()) {
+    while (placed.size() < unplaced.size()) {
         // Choose step with lowest offset
-        auto &step = cont.FindMinBy(CmpByOffset);
+        auto &step = cont.Lowest();
 
         // Find best fit for this step
-        auto bestFitPos = MinPosWithConstr(
-            unplaced, [&](auto &desc) { return step.CanPlace(desc); },
-            CmpByLengthInv);
+        auto bestFit = index.BestFit(step.begin, step.End());
 
         // Lift this step if no block can be placed
-        if (!bestFitPos.has_value()) {
+        if (bestFit == UnplacedIndex::NONE) {
             cont.Lift(step.begin);
             continue;
         }
 
         // Place best fit block at the step
-        auto block = *bestFitPos.value();
+        auto block = unplaced[bestFit];
         block.offset = cont.Place(block.gen, block.Length(), block.size);
         placed.push_back(std::move(block));
-        unplaced.erase(bestFitPos.value());
+        index.Remove(bestFit);
     }
 
     return MemoryPlan(cont.GetMaxHeight(), std::move(placed));
 }
 
+/// Place blocks one by one in the given order, each at the lowest aligned
+/// offset in the gaps among placed blocks alive at the same time
+static MemoryPlan placeGreedy(std::vector<MemoryDesc> &&descs,
+                              const LifetimeStat &stat, uint64_t alignment) {
+    auto &policy = AlignPolicy::Get();
+    IntervalTree tree(stat.range.first, stat.range.second);
+    std::vector<uint32_t> conflicts;
+    uint64_t peak = 0;
+    for (auto [i, desc] : EnumRange(descs)) {
+        conflicts.clear();
+        tree.Query(desc.gen, desc.kill, conflicts);
+        std::sort(conflicts.begin(), conflicts.end(), [&](auto lhs, auto rhs) {
+            return descs[lhs].offset < descs[rhs].offset;
+        });
+        auto align =
+            std::lcm(alignment, policy.Alignment(desc.value->type.dtype));
+        uint64_t offset = 0;
+        for (auto j : conflicts) {
+            auto &other = descs[j];
+            if (alignUp(offset, align) + desc.size <= other.offset) break;
+            offset = std::max(offset, other.offset + other.size);
+        }
+        desc.offset = alignUp(offset, align);
+        peak = std::max(peak, desc.offset + desc.size);
+        tree.Insert(desc.gen, desc.kill, uint32_t(i));
+    }
+
+    return MemoryPlan(peak, std::move(descs));
+}
+
+MemoryPlan GreedyBySize(const LifetimeStat &stat, uint64_t alignment) {
+    auto descs = createDescs(stat);
+    std::stable_sort(descs.begin(), descs.end(), CmpBySizeInv);
+    return placeGreedy(std::move(descs), stat, alignment);
+}
+
+MemoryPlan GreedyByBreadth(const LifetimeStat &stat, uint64_t alignment) {
+    // Rank times by total size of values alive
+    MemoryTimeline timeline(stat);
+    auto &profile = timeline.Profile();
+    std::vector<uint32_t> times(profile.size());
+    std::iota(times.begin(), times.end(), 0);
+    std::stable_sort(times.begin(), times.end(), [&](auto lhs, auto rhs) {
+        return profile[lhs] > profile[rhs];
+    });
+
+    // Each block is placed when its first time in rank order is visited
+    RangeMaxVec<int64_t> negRanks(profile.size());
+    for (auto [rank, t] : EnumRange(times)) negRanks.Add(t, t + 1, -rank);
+    auto descs = createDescs(stat);
+    auto key = [&](const MemoryDesc &desc) {
+        return -negRanks.Max(desc.gen - timeline.Begin(),
+                             desc.kill - timeline.Begin());
+    };
+    std::vector<std::pair<int64_t, MemoryDesc>> keyed;
+    for (auto &desc : descs) keyed.push_back({key(desc), desc});
+    std::stable_sort(keyed.begin(), keyed.end(), [](auto &lhs, auto &rhs) {
+        if (lhs.first != rhs.first) return lhs.first < rhs.first;
+        return CmpBySizeInv(lhs.second, rhs.second);
+    });
+
+    descs = Transform<std::vector<MemoryDesc>>(
+        keyed, [](auto &pair) { return pair.second; });
+    return placeGreedy(std::move(descs), stat, alignment);
+}
+
+MemoryPlan GreedyByConflict(const LifetimeStat &stat, uint64_t alignment) {
+    // Count blocks overlapping each one, which are those neither ending before
+    // it begins nor beginning after it ends
+    auto descs = createDescs(stat);
+    std::vector<int32_t> gens, kills;
+    for (auto &desc : descs) {
+        gens.push_back(desc.gen);
+        kills.push_back(desc.kill);
+    }
+    std::sort(gens.begin(), gens.end());
+    std::sort(kills.begin(), kills.end());
+    auto nConflicts = [&](const MemoryDesc &desc) {
+        auto killed = std::upper_bound(kills.begin(), kills.end(), desc.gen) -
+                      kills.begin();
+        auto unborn =
+            gens.end() - std::lower_bound(gens.begin(), gens.end(), desc.kill);
+        return int64_t(descs.size()) - killed - unborn;
+    };
+
+    // Place blocks with most conflicts first
+    std::vector<std::pair<int64_t, MemoryDesc>> keyed;
+    for (auto &desc : descs) keyed.push_back({nConflicts(desc), desc});
+    std::stable_sort(keyed.begin(), keyed.end(), [](auto &lhs, auto &rhs) {
+        if (lhs.first != rhs.first) return lhs.first > rhs.first;
+        return CmpBySizeInv(lhs.second, rhs.second);
+    });
+
+    descs = Transform<std::vector<MemoryDesc>>(
+        keyed, [](auto &pair) { return pair.second; });
+    return placeGreedy(std::move(descs), stat, alignment);
+}
+
+std::vector<Planner> AllPlanners() {
+    return {
+        {"best-fit", BestFit},
+        {"greedy-by-size", [](auto &stat) { return GreedyBySize(stat); }},
+        {"greedy-by-breadth", [](auto &stat) { return GreedyByBreadth(stat); }},
+        {"greedy-by-conflict",
+         [](auto &stat) { return GreedyByConflict(stat); }},
+    };
+}
+
+MemoryPlan PortfolioPlan(const LifetimeStat &stat,
+                         std::vector<PlannerStat> *stats) {
+    // Run all planners concurrently
+    auto planners = AllPlanners();
+    std::vector<std::optional<MemoryPlan>> plans(planners.size());
+    std::vector<int64_t> times(planners.size());
+    ParallelFor(planners.size(), [&](size_t i) {
+        auto begin = std::chrono::steady_clock::now();
+        plans[i] = planners[i].plan(stat);
+        times[i] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       std::chrono::steady_clock::now() - begin)
+                       .count();
+    });
+
+    // Choose plan with smallest arena
+    auto best = 0u;
+    for (auto i = 0u; i < planners.size(); i++) {
+        if (plans[i]->peak < plans[best]->peak) best = i;
+        if (stats)
+            stats->push_back({planners[i].name, plans[i]->peak, times[i]});
+    }
+
+    return std::move(*plans[best]);
+}
+
 }  // namespace hmcos
\ No newline at end of file
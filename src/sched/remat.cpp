@@ -0,0 +1,199 @@
+#include <cmath>
+#include <hmcos/sched/remat.hpp>
+#include <hmcos/sched/sched.hpp>
+#include <hmcos/util/fmt.hpp>
+
+namespace hmcos {
+
+double DefaultRematCost(const OpRef &op) {
+    auto costPerElem = op->Traits().rematCost;
+    if (!std::isfinite(costPerElem)) return costPerElem;
+    double count = 0;
+    for (auto &in : op->inputs) count += double(in->type.Count());
+    return costPerElem * count;
+}
+
+/// Recompute `val` with a copy of its definition inserted to the schedule at
+/// `split`. The copy takes over all uses of `val` from `split` on. Vertices
+/// are not connected, which is only needed if this recomputation is kept.
+static OpRef applyRemat(const ValueRef &val, size_t split, size_t idx,
+                        const std::unordered_map<OpRef, size_t> &pos,
+                        std::vector<OpRef> &sched, Graph &graph) {
+    // Copy definition
+    auto def = val->def.lock();
+    auto remat = std::make_shared<Op>(*def);
+    remat->name = fmt::format("{}:remat{}", def->name, idx);
+    remat->inputs = def->inputs;
+    for (auto &in : remat->inputs) in->uses.push_back(remat);
+    auto newVal = std::make_shared<Value>(*val);
+    newVal->name = fmt::format("{}:remat{}", val->name, idx);
+    newVal->def = remat;
+    remat->outputs.push_back(newVal);
+    if (def->workspace) {
+        auto ws = std::make_shared<Value>(*def->workspace);
+        ws->name = remat->name + ":workspace";
+        ws->def = remat;
+        remat->workspace = ws;
+    }
+
+    // Move later uses to recomputed value
+    std::vector<std::weak_ptr<Op>> earlier;
+    for (auto &use : val->uses) {
+        auto op = use.lock();
+        if (pos.at(op) < split) {
+            earlier.push_back(use);
+            continue;
+        }
+        std::replace(op->inputs.begin(), op->inputs.end(), val, newVal);
+        newVal->uses.push_back(use);
+    }
+    val->uses = std::move(earlier);
+
+    // Keep ops in graph topologically sorted
+    auto firstUse =
+        std::find_if(graph.ops.begin(), graph.ops.end(), [&](auto &op) {
+            return Contains(op->inputs, newVal);
+        });
+    graph.ops.insert(firstUse, remat);
+    sched.insert(sched.begin() + split, remat);
+
+    return remat;
+}
+
+static void revertRemat(const OpRef &remat, const ValueRef &val,
+                        std::vector<OpRef> &sched, Graph &graph) {
+    auto &newVal = remat->outputs[0];
+    for (auto &use : newVal->uses) {
+        auto op = use.lock();
+        std::replace(op->inputs.begin(), op->inputs.end(), newVal, val);
+        val->uses.push_back(use);
+    }
+    for (auto &in : remat->inputs)
+        RemoveIf(in->uses, [&](auto &use) { return use.lock() == remat; });
+    Remove(sched, remat);
+    Remove(graph.ops, remat);
+}
+
+static void connectRemat(const OpRef &remat, const ValueRef &val) {
+    auto def = val->def.lock();
+    for (auto &in : remat->inputs) {
+        if (in->kind == ValueKind::PARAM) continue;
+        Vertex::Connect(in->Vertex(), remat);
+    }
+    for (auto &use : remat->outputs[0]->uses) {
+        auto op = use.lock();
+        Vertex::Connect(remat, op);
+        auto usesDef =
+            std::any_of(op->inputs.begin(), op->inputs.end(), [&](auto &in) {
+                return in->kind == ValueKind::RESULT && in->def.lock() == def;
+            });
+        if (!usesDef) Vertex::Disconnect(def, op);
+    }
+}
+
+/// Value recomputed right before its use at `split`
+struct RematCandidate {
+    ValueRef val;
+    size_t split;
+    double cost;
+};
+
+/// Values alive across time `t` without being used there, which are used both
+/// before and after `t` and can be recomputed
+static std::vector<RematCandidate> findCandidates(
+    const MemoryTimeline &timeline, int32_t t,
+    const std::unordered_map<OpRef, size_t> &pos, const Graph &graph,
+    const RematCostFunc &costFunc) {
+    std::unordered_set<ValueRef> outputs;
+    for (auto &out : graph.outputs) outputs.insert(out->value);
+
+    std::vector<RematCandidate> candidates;
+    for (auto &val : timeline.AliveValues(t)) {
+        // Only values owning memory alone can be recomputed
+        if (val->kind != ValueKind::RESULT || val->IsView() ||
+            !val->views.empty() || Contains(outputs, val))
+            continue;
+        auto def = val->def.lock();
+        if (def->workspace == val || def->outputs.size() != 1) continue;
+        // Values passed inside a fused kernel are not available any more
+        if (std::any_of(def->inputs.begin(), def->inputs.end(),
+                        [](auto &in) { return in->fused; }))
+            continue;
+        auto cost = costFunc(def);
+        if (!std::isfinite(cost)) continue;
+
+        // Split uses at this time
+        auto before = false, at = false;
+        auto split = SIZE_MAX;
+        for (auto &use : val->uses) {
+            auto p = int32_t(pos.at(use.lock()));
+            if (p < t)
+                before = true;
+            else if (p == t)
+                at = true;
+            else
+                split = std::min(split, size_t(p));
+        }
+        if (!before || at || split == SIZE_MAX) continue;
+        candidates.push_back({val, split, cost});
+    }
+
+    return candidates;
+}
+
+RematResult RematSchedule(Graph &graph, uint64_t budget,
+                          const RematCostFunc &costFunc) {
+    // Try to fit the budget without recomputation
+    RematResult result;
+    result.sched = FeasibleSchedule(graph, budget);
+    if (result.sched.empty()) result.sched = HierarchicalSchedule(graph);
+    auto &sched = result.sched;
+
+    while (true) {
+        auto stat = ComputeLifetime(sched, graph);
+        MemoryTimeline timeline(stat);
+        if (timeline.Peak() <= budget) break;
+
+        // Find candidates alive across the first peak
+        std::unordered_map<OpRef, size_t> pos;
+        for (auto [i, op] : EnumRange(sched)) pos.insert({op, i});
+        auto peakTime = timeline.PeakTimes()[0];
+        auto candidates =
+            findCandidates(timeline, peakTime, pos, graph, costFunc);
+
+        // Pick the one removing the most excess per unit cost
+        auto excess = timeline.Excess(budget);
+        auto idx = result.remats.size();
+        std::optional<RematCandidate> best;
+        double bestScore = 0;
+        for (auto &cand : candidates) {
+            auto remat =
+                applyRemat(cand.val, cand.split, idx, pos, sched, graph);
+            auto newStat = ComputeLifetime(sched, graph);
+            auto newExcess = MemoryTimeline(newStat).Excess(budget);
+            revertRemat(remat, cand.val, sched, graph);
+            if (newExcess >= excess) continue;
+            auto score = double(excess - newExcess) / std::max(cand.cost, 1.);
+            if (score <= bestScore) continue;
+            best = cand;
+            bestScore = score;
+        }
+        if (!best) break;
+
+        // Keep recomputation
+        auto remat = applyRemat(best->val, best->split, idx, pos, sched, graph);
+        connectRemat(remat, best->val);
+        result.remats.push_back(remat);
+        result.cost += best->cost;
+    }
+
+    result.stat = ComputeLifetime(sched, graph);
+    result.peak = MemoryTimeline(result.stat).Peak();
+    LOG_IF(WARNING, result.peak > budget) << fmt::format(
+        "Peak {} exceeds budget {} after recomputing {} values.", result.peak,
+        budget, result.remats.size());
+
+    return result;
+}
+
+}  // namespace hmcos
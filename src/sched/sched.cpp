@@ -1,9 +1,15 @@
+#include <hmcos/core/alias.hpp>
 #include <hmcos/sched/life.hpp>
 #include <hmcos/sched/mem.hpp>
 #include <hmcos/sched/pass.hpp>
+#include <hmcos/sched/plan.hpp>
 #include <hmcos/sched/sched.hpp>
+#include <hmcos/util/parallel.hpp>
 #include <hmcos/util/progress.hpp>
+#include <atomic>
+#include <deque>
 #include <hmcos/util/viz.hpp>
+#include <mutex>
 
 namespace hmcos {
 
@@ -120,7 +126,13 @@ struct PartialSchedResult : public SchedResult {
           predCnt(std::move(predCnt)),
           useCnt(std::move(useCnt)) {}
 
+    /// Keep the partial schedule with lower peak. Both schedules reach the
+    /// same zero-indegree set, which determines the set of scheduled
+    /// vertices, and in turn the values alive afterwards. Their latest states
+    /// are therefore equal, so (peak, latest) pairs are totally ordered by
+    /// peak and no other state needs to be kept.
     void Update(PartialSchedResult &&other) {
+        LOG_ASSERT(other.states.Latest() == this->states.Latest());
         if (other.states.Peak() < this->states.Peak()) {
             this->seq.swap(other.seq);
             this->states.Swap(other.states);
@@ -130,6 +142,10 @@ struct PartialSchedResult : public SchedResult {
     }
 };
 
+/// Partial schedules of one DP step, keyed by zero-indegree set
+using DpLayer =
+    std::unordered_map<std::vector<HierVertRef>, PartialSchedResult>;
+
 struct GroupContext {
     /// Group that this context describes
     GroupRef group;
@@ -170,27 +186,39 @@ static SchedResult scheduleSequence(
     int64_t budget) {
     // Iterate each op and compute memory states
     MemStateVec states;
-    for (auto &op : seq->ops) {
-        // Find all values killed by this operator
-        std::vector<ValueRef> killed;
-        for (auto &val : op->inputs) {
-            if (val->kind == ValueKind::PARAM) continue;
-            auto cnt = --useCnt[val];
-            if (cnt == 0) killed.push_back(val);
+    auto isAlive = [&](const ValueRef &val) { return Contains(useCnt, val); };
+    for (auto [op, mem] : ZipRange(seq->ops, seq->mems)) {
+        // Kill owners of input memory whose uses are all done. Uses of views
+        // are counted on their owners.
+        uint64_t killSize = 0;
+        auto ovlKilled = false;
+        for (auto [i, p] : EnumRange(mem.owners)) {
+            auto &[owner, nUses] = p;
+            auto &cnt = useCnt[owner];
+            cnt -= nUses;
+            if (cnt != 0) continue;
+            useCnt.erase(owner);
+            killSize += mem.packs[i] ? PackedSize(owner, mem.packs[i], isAlive)
+                                     : mem.sizes[i];
+            ovlKilled |= i == mem.overlap;
+        }
+
+        // Allocate blocks of packed outputs
+        uint64_t packSize = 0;
+        for (auto &[out, pack] : mem.outPacks) {
+            packSize += PackedSize(out, pack, isAlive);
+            useCnt.insert({out, out->MemUseCount()});
         }
 
         // Update memory states
-        auto [inc, dec] = ComputeIncDec(op, killed);
+        auto [inc, dec] = mem.IncDec(killSize, ovlKilled, packSize);
         auto [s, t] = states.ComputeState(inc, dec);
         if (s > budget) return {};
         states.Append(inc, dec);
 
-        // Remove killed values from use count map
-        for (auto &val : killed) useCnt.erase(val);
-
         // Update use count for values generated by this op
         for (auto &val : op->outputs)
-            useCnt.insert({val, uint32_t(val->uses.size())});
+            if (!val->IsView()) useCnt.insert({val, val->MemUseCount()});
     }
 
     return {std::vector(seq->ops), std::move(states)};
@@ -224,7 +252,7 @@ static void updateResult(
     const HierVertRef &vert, const std::vector<HierVertRef> &zeroIn,
     const PartialSchedResult &result, SchedResult &&vertResult,
     std::unordered_map<ValueRef, uint32_t> &&useCnt,
-    std::unordered_map<std::vector<HierVertRef>, PartialSchedResult> &newMemo) {
+    DpLayer &newMemo) {
     // Do nothing if the result is invalid
     if (!vertResult.valid) return;
 
@@ -265,7 +293,7 @@ static SchedResult scheduleGroupDp(
     // Initialize memoization map
     std::vector<HierVertRef> zeroIn;
     extractZeroIn(predCnt, zeroIn);
-    std::unordered_map<std::vector<HierVertRef>, PartialSchedResult> memo;
+    DpLayer memo;
     memo.insert(
         {zeroIn,
          {{}, MemStateVec(), std::move(predCnt), std::unordered_map(useCnt)}});
@@ -308,65 +336,246 @@ static void updateGroupUseCount(
     useCnt.insert(group->produced.begin(), group->produced.end());
 }
 
+/// Scheduling results of groups under different contexts, shared by
+/// schedulers running concurrently
+struct GroupMemo {
+    std::unordered_map<GroupContext, SchedResult> results;
+    std::mutex mutex;
+};
+
+/// A range of top level vertices delimited by cut vertices. All ops before a
+/// segment must be scheduled before any op in it, so each segment can be
+/// scheduled independently.
+struct Segment {
+    /// Vertices of this segment in topological order
+    std::vector<HierVertRef> verts;
+    /// Use count of values alive at the beginning of this segment
+    std::unordered_map<ValueRef, uint32_t> useCnt;
+    /// Memory occupied by these values
+    int64_t offset = 0;
+};
+
+/// Update use count as if all ops of the vertex have been scheduled
+static void updateVertUseCount(const HierVertRef &vert,
+                               std::unordered_map<ValueRef, uint32_t> &useCnt) {
+    if (Is<Group>(vert)) {
+        updateGroupUseCount(Cast<Group>(vert), useCnt);
+        return;
+    }
+    for (auto &op : Cast<Sequence>(vert)->ops) {
+        for (auto &val : op->inputs) {
+            if (val->kind == ValueKind::PARAM) continue;
+            ForEachOwner(val, [&](const ValueRef &owner) {
+                if (--useCnt[owner] == 0) useCnt.erase(owner);
+            });
+        }
+        for (auto &val : op->outputs)
+            if (!val->IsView()) useCnt.insert({val, val->MemUseCount()});
+    }
+}
+
+/// Total size of values in use count map. Blocks of packed owners are
+/// counted once as long as any of them is alive.
+static int64_t aliveSize(const std::unordered_map<ValueRef, uint32_t> &useCnt) {
+    int64_t size = 0;
+    std::unordered_set<ValueRef> packs;
+    for (auto &[val, _] : useCnt) {
+        auto pack = PackOf(val);
+        if (!pack)
+            size += val->type.Size();
+        else if (packs.insert(pack).second)
+            size += pack->type.Size();
+    }
+    return size;
+}
+
+/// Split top level of hierarchical graph into segments. A vertex ends a
+/// segment if every other vertex is either its ancestor or its descendant.
+static std::vector<Segment> splitSegments(const HierGraph &hier) {
+    // Collect top level vertices in topological order
+    std::vector<HierVertRef> verts;
+    for (auto vert : RpoHierRange(hier))
+        if (!Is<HierInput>(vert) && !Is<HierOutput>(vert))
+            verts.push_back(vert);
+    std::unordered_map<HierVertRef, size_t> pos;
+    for (auto [i, vert] : EnumRange(verts)) pos.insert({vert, i});
+
+    // Find the last source and the first sink. A vertex before a source or
+    // after a sink cannot be a cut vertex.
+    size_t lastSrc = 0, firstSink = verts.size();
+    for (auto [i, vert] : EnumRange(verts)) {
+        auto preds = vert->Preds();
+        if (std::all_of(preds.begin(), preds.end(),
+                        [](auto &pred) { return Is<HierInput>(pred); }))
+            lastSrc = i;
+        if (firstSink == verts.size() &&
+            std::all_of(vert->succs.begin(), vert->succs.end(),
+                        [](auto &succ) { return Is<HierOutput>(succ); }))
+            firstSink = i;
+    }
+
+    // Cut at vertices which no edge from preceding vertices goes over
+    std::unordered_map<ValueRef, uint32_t> useCnt;
+    for (auto &input : hier.inputs) {
+        auto &val = input->value;
+        useCnt.insert({val, val->MemUseCount()});
+    }
+    std::vector<Segment> segments(1, {{}, useCnt, aliveSize(useCnt)});
+    size_t reach = 0;
+    for (auto [i, vert] : EnumRange(verts)) {
+        segments.back().verts.push_back(vert);
+        updateVertUseCount(vert, useCnt);
+        auto isCut = reach <= i && lastSrc <= i && i <= firstSink;
+        for (auto &succ : vert->succs)
+            if (!Is<HierOutput>(succ)) reach = std::max(reach, pos[succ]);
+        if (!isCut || i + 1 == verts.size()) continue;
+
+        // Values alive at this cut are the initial state of next segment
+        segments.push_back({{}, useCnt, aliveSize(useCnt)});
+    }
+
+    return segments;
+}
+
 class HierScheduler {
 public:
-    HierScheduler(const HierGraph &hier, int64_t budget,
-                  std::unordered_map<GroupContext, SchedResult> &groupMemo)
-        : hier(hier), budget(budget), groupMemo(groupMemo) {}
-
+    HierScheduler(const Segment &segment, int64_t budget, GroupMemo &groupMemo,
+                  std::vector<DpLayer> &layers)
+        : segment(segment),
+          budget(budget),
+          groupMemo(groupMemo),
+          layers(layers) {}
+
+    /// Find the schedule of this segment with minimal peak. Return an empty
+    /// schedule if no one fits in the budget.
+    template <bool displayProgress>
     std::vector<OpRef> Schedule() {
-        // Initialize predecessor count of vertices
-        std::unordered_map<HierVertRef, uint32_t> predCnt;
-        for (auto vert : RpoHierRange(hier)) {
-            if (Is<HierInput>(vert) || Is<HierOutput>(vert)) continue;
-            predCnt.insert({vert, uint32_t(vert->preds.size())});
+        // Resume from the last layer kept from previous scheduling. Partial
+        // results beyond current budget are dropped, which is exactly what a
+        // fresh run would have pruned.
+        while (!layers.empty()) {
+            auto &last = layers.back();
+            for (auto it = last.begin(); it != last.end();)
+                if (it->second.states.Peak() > budget)
+                    it = last.erase(it);
+                else
+                    it++;
+            if (!last.empty()) break;
+            layers.pop_back();
         }
-        auto nVert = predCnt.size();
-
-        // Initialize use count of values
-        std::unordered_map<ValueRef, uint32_t> useCnt;
-        for (auto &input : hier.inputs) {
-            for (auto &succ : input->succs) predCnt[succ]--;
-            auto &val = input->value;
-            useCnt.insert({val, uint32_t(val->uses.size())});
+        if (layers.empty()) layers.push_back(initLayer());
+
+        // Iterate remaining steps, keeping partial results of each step
+        auto nVert = segment.verts.size();
+        auto nDone = layers.size() - 1;
+        for (auto i : ProgressRange<displayProgress>(nVert - nDone)) {
+            // Iterate each partial result and build partial schedule with one
+            // more vertex
+            DpLayer newMemo;
+            for (const auto &[zeroIn, result] : layers.back())
+                expand(zeroIn, result, newMemo);
+            if (newMemo.empty()) {
+                layers.clear();
+                return {};
+            }
+            layers.push_back(std::move(newMemo));
+        }
+
+        return layers.back()[{}].seq;
+    }
+
+    /// Search any schedule of this segment within budget. Partial schedules
+    /// are extended depth-first, preferring the one which leaves least memory
+    /// occupied. Zero-indegree sets that cannot be completed are memoized.
+    /// Return false if there is no such schedule or search is cancelled.
+    bool Search(std::vector<OpRef> &sched, const std::atomic<bool> &cancel) {
+        // Each frame holds partial schedules with one more vertex than its
+        // parent, and the next one to be tried
+        struct Frame {
+            std::vector<HierVertRef> zeroIn;
+            std::vector<std::pair<std::vector<HierVertRef>, PartialSchedResult>>
+                children;
+            size_t next = 0;
+        };
+        auto makeFrame = [&](const std::vector<HierVertRef> &zeroIn,
+                             const PartialSchedResult &result) {
+            DpLayer children;
+            expand(zeroIn, result, children);
+            Frame frame{zeroIn, {children.begin(), children.end()}};
+            std::sort(frame.children.begin(), frame.children.end(),
+                      [](auto &lhs, auto &rhs) {
+                          auto &ls = lhs.second.states, &rs = rhs.second.states;
+                          return std::make_pair(ls.Latest(), ls.Peak()) <
+                                 std::make_pair(rs.Latest(), rs.Peak());
+                      });
+            return frame;
+        };
+
+        // Search from initial state
+        auto init = initLayer();
+        auto &[initZeroIn, initResult] = *init.begin();
+        std::unordered_set<std::vector<HierVertRef>> dead;
+        std::vector<Frame> stack;
+        stack.push_back(makeFrame(initZeroIn, initResult));
+        while (!stack.empty()) {
+            if (cancel) return false;
+            auto &top = stack.back();
+            if (top.next == top.children.size()) {
+                dead.insert(std::move(top.zeroIn));
+                stack.pop_back();
+                continue;
+            }
+            auto [zeroIn, result] = std::move(top.children[top.next++]);
+            if (zeroIn.empty()) {
+                sched = std::move(result.seq);
+                return true;
+            }
+            if (Contains(dead, zeroIn)) continue;
+            stack.push_back(makeFrame(zeroIn, result));
+        }
+
+        return false;
+    }
+
+private:
+    /// Add each vertex in zero-indegree set to the partial schedule
+    void expand(const std::vector<HierVertRef> &zeroIn,
+                const PartialSchedResult &result, DpLayer &newMemo) {
+        for (auto &vert : zeroIn) {
+            auto useCnt = result.useCnt;
+            auto vertResult = scheduleVertex(vert, useCnt, result.states);
+            updateResult(vert, zeroIn, result, std::move(vertResult),
+                         std::move(useCnt), newMemo);
+        }
+    }
+
+    DpLayer initLayer() {
+        // Initialize predecessor count of vertices, only counting those in
+        // this segment
+        std::unordered_set<HierVertRef> inSeg(segment.verts.begin(),
+                                              segment.verts.end());
+        std::unordered_map<HierVertRef, uint32_t> predCnt;
+        for (auto &vert : segment.verts) {
+            auto preds = vert->Preds();
+            predCnt.insert({vert, uint32_t(std::count_if(
+                                      preds.begin(), preds.end(),
+                                      [&](auto &pred) {
+                                          return Contains(inSeg, pred);
+                                      }))});
         }
 
         // Initialize memoization map
         std::vector<HierVertRef> zeroIn;
         extractZeroIn(predCnt, zeroIn);
-        auto initSize = std::transform_reduce(
-            hier.inputs.begin(), hier.inputs.end(), 0ull, std::plus(),
-            [](auto &input) { return input->value->type.Size(); });
-        std::unordered_map<std::vector<HierVertRef>, PartialSchedResult> memo;
+        DpLayer memo;
         memo.insert({zeroIn,
                      {{},
-                      MemStateVec(initSize),
+                      MemStateVec(segment.offset),
                       std::move(predCnt),
-                      std::move(useCnt)}});
-
-        // Iterate |V| steps
-        for (auto i : ProgressRange(nVert)) {
-            // Iterate each partial result and build partial schedule with one
-            // more vertex
-            decltype(memo) newMemo;
-            for (const auto &[zeroIn, result] : memo) {
-                // Add another vertex to the schedule
-                for (auto &vert : zeroIn) {
-                    auto useCnt = result.useCnt;
-                    auto vertResult =
-                        scheduleVertex(vert, useCnt, result.states);
-                    updateResult(vert, zeroIn, result, std::move(vertResult),
-                                 std::move(useCnt), newMemo);
-                }
-            }
-            LOG_ASSERT(!newMemo.empty());
-            newMemo.swap(memo);
-        }
-
-        return memo[{}].seq;
+                      std::unordered_map(segment.useCnt)}});
+        return memo;
     }
 
-private:
     SchedResult scheduleVertex(const HierVertRef &vert,
                                std::unordered_map<ValueRef, uint32_t> &useCnt,
                                const MemStateVec &prevStates) {
@@ -380,20 +589,27 @@ private:
                                         localBudget);
 
             case HierKind::GROUP: {
-                // Check if there is memoized result
+                // Check if there is memoized result. Entries are never
+                // modified once inserted, so they can be read without lock.
                 auto group = Cast<Group>(vert);
                 GroupContext ctx(group, useCnt);
-                if (Contains(groupMemo, ctx)) {
+                const SchedResult *memoResult = nullptr;
+                {
+                    std::lock_guard<std::mutex> lock(groupMemo.mutex);
+                    auto it = groupMemo.results.find(ctx);
+                    if (it != groupMemo.results.end())
+                        memoResult = &it->second;
+                }
+                if (memoResult) {
                     // Check if it exceeds local budget
-                    auto &memoResult = groupMemo[ctx];
-                    if (memoResult.states.Peak() > localBudget)
+                    if (memoResult->states.Peak() > localBudget)
                         // Cannot schedule within budget, abandon this partial
                         // schedule
                         return {};
                     else {
                         // Use memoized result, also update use count
                         updateGroupUseCount(group, useCnt);
-                        return groupMemo[ctx];
+                        return *memoResult;
                     }
                 }
 
@@ -414,7 +630,8 @@ private:
                     scheduleGroupDp<false>(group, useCnt, localBudget);
                 if (!dpResult.valid) return {};
                 updateGroupUseCount(group, useCnt);
-                groupMemo.insert({ctx, dpResult});
+                std::lock_guard<std::mutex> lock(groupMemo.mutex);
+                groupMemo.results.insert({ctx, dpResult});
                 return dpResult;
             }
 
@@ -424,12 +641,22 @@ private:
         LOG(FATAL) << "Unreachable.";
     }
 
-    /// Hierarchical graph to be scheduled
-    const HierGraph &hier;
+    /// Segment of hierarchical graph to be scheduled
+    const Segment &segment;
     /// Upper bound of acceptable peak
     const int64_t budget;
     /// Scheduling result of each group, under different contexts
-    std::unordered_map<GroupContext, SchedResult> &groupMemo;
+    GroupMemo &groupMemo;
+    /// Partial results of each DP step, kept across iterations
+    std::vector<DpLayer> &layers;
+};
+
+/// DP layers of a segment, kept across iterations
+struct SegmentLayers {
+    /// Vertices of the segment
+    std::unordered_set<HierVertRef> verts;
+    /// Partial results of each DP step
+    std::vector<DpLayer> layers;
 };
 
 using VertListFunc =
@@ -508,91 +735,414 @@ static void ungroup(const GroupRef &group) {
     for (auto &seq : group->seqs) seq->group = {};
 }
 
-static bool tryUngroupSucc(const SequenceRef &seq) {
-    bool changed = false;
-    while (true) {
-        bool iterChanged = false;
-        for (auto &succ : seq->succs) {
-            if (Is<Group>(succ)) {
-                ungroup(Cast<Group>(succ));
-                iterChanged = changed = true;
-                break;
-            }
+/// Split a group so that `core` sequences, together with their descendants
+/// (or ancestors if `upward`) inside the group, form a smaller group, while
+/// the rest of the sequences stay grouped. A part with only one sequence is
+/// left ungrouped. If the part covers the whole group, the group is simply
+/// dissolved. Return the groups created.
+static std::vector<GroupRef> splitGroup(const GroupRef &group,
+                                        const std::vector<SequenceRef> &core,
+                                        bool upward) {
+    // Find closure of core sequences inside the group
+    std::unordered_set<SequenceRef> part;
+    std::vector<SequenceRef> stack(core);
+    while (!stack.empty()) {
+        auto seq = stack.back();
+        stack.pop_back();
+        if (!part.insert(seq).second) continue;
+        for (auto &vert : upward ? seq->Preds() : seq->Succs())
+            if (group->Contains<Sequence>(vert))
+                stack.push_back(Cast<Sequence>(vert));
+    }
+    std::unordered_set<SequenceRef> rest;
+    for (auto &seq : group->seqs)
+        if (!Contains(part, seq)) rest.insert(seq);
+
+    // Dissolve the group and regroup each part
+    ungroup(group);
+    std::vector<GroupRef> created;
+    if (rest.empty()) return created;
+    for (auto set : {&part, &rest})
+        if (set->size() > 1) created.push_back(GroupSequences(*set));
+
+    return created;
+}
+
+/// Recompute predecessor count of vertices whose edges are changed by
+/// splitting groups. Return false if any of these vertices, or any removed
+/// group, would be ready in this partial result, which means the result cannot
+/// be reused as is.
+static bool repairPredCount(PartialSchedResult &result,
+                            const std::vector<HierVertRef> &zeroIn,
+                            const std::vector<GroupRef> &removed,
+                            const std::unordered_set<HierVertRef> &added,
+                            const std::vector<HierVertRef> &affected) {
+    // Removed groups must not be ready or scheduled
+    auto &predCnt = result.predCnt;
+    for (auto &group : removed)
+        if (predCnt.erase(group) == 0) return false;
+
+    // Count unscheduled predecessors of affected vertices
+    auto isUnscheduled = [&](const HierVertRef &vert) {
+        return Contains(predCnt, vert) || Contains(zeroIn, vert) ||
+               Contains(added, vert);
+    };
+    for (auto &vert : affected) {
+        auto cnt = uint32_t(std::count_if(
+            vert->preds.begin(), vert->preds.end(),
+            [&](auto &pred) { return isUnscheduled(pred.lock()); }));
+        if (cnt == 0) return false;
+        predCnt[vert] = cnt;
+    }
+
+    return true;
+}
+
+/// Drop DP layers of a segment affected by removed groups and repair the
+/// rest, so that the next scheduling iteration restarts from the earliest
+/// affected layer. `added` are top level vertices that replace sequences of
+/// removed groups. Vertex set of the segment is updated accordingly.
+static void invalidateLayers(SegmentLayers &segLayers,
+                             const std::vector<GroupRef> &removed,
+                             const std::unordered_set<HierVertRef> &added) {
+    // Update vertices of this segment
+    auto &verts = segLayers.verts;
+    for (auto &group : removed) verts.erase(group);
+    verts.insert(added.begin(), added.end());
+
+    // Collect vertices in this segment with changed predecessors
+    std::vector<HierVertRef> affected(added.begin(), added.end());
+    for (auto &vert : added) {
+        for (auto &succ : vert->succs) {
+            if (!Contains(verts, succ) || Contains(added, succ)) continue;
+            AddUnique(affected, succ);
+        }
+    }
+
+    // Find the first layer that cannot be reused
+    auto &layers = segLayers.layers;
+    for (auto i = 0u; i < layers.size(); i++) {
+        bool valid = true;
+        for (auto &[zeroIn, result] : layers[i]) {
+            valid = repairPredCount(result, zeroIn, removed, added, affected);
+            if (!valid) break;
+        }
+        if (!valid) {
+            layers.resize(i);
+            return;
         }
-        if (!iterChanged) break;
     }
-    return changed;
 }
 
 // Make sure subtracting any integer (positive or negative) not so big from it
 // will never overflow.
 static constexpr auto MAX_BUDGET = INT64_MAX / 2;
 
-std::vector<OpRef> HierarchicalSchedule(const Graph &graph) {
+std::vector<OpRef> HierarchicalSchedule(const Graph &graph,
+                                        SchedObjective objective) {
     // Build hierarchical graph
     HierGraph hier(graph);
     RunPass<JoinSequencePass, MakeGroupPass>(hier);
 
     // Initialize memoization map for sharing results across iterations
-    std::unordered_map<GroupContext, SchedResult> groupMemo;
+    GroupMemo groupMemo;
+    std::vector<SegmentLayers> segLayers;
+
+    // No schedule can have a peak lower than this bound
+    auto bound = PeakLowerBound(graph);
+    LOG(INFO) << "Lower bound: " << bound / 1024;
 
-    // Record schedule and peak
+    // Record best schedule and its cost, which also serves as budget of DP.
+    // Arena size is never lower than peak, so schedules whose peaks are below
+    // the best arena size can still improve it.
     std::vector<OpRef> lastSched;
-    uint64_t lastPeak = MAX_BUDGET;
+    uint64_t lastCost = MAX_BUDGET, prevPeak = MAX_BUDGET;
+
+    // Map groups produced by splitting to groups they originate from
+    std::unordered_map<GroupRef, GroupRef> origins;
 
     // Iteratively schedule hierarchical graph
     while (true) {
-        auto sched = HierScheduler(hier, lastPeak, groupMemo).Schedule();
+        // Reuse DP layers of segments whose vertices are unchanged
+        auto segments = splitSegments(hier);
+        std::vector<SegmentLayers> newSegLayers;
+        for (auto &seg : segments) {
+            auto it = std::find_if(
+                segLayers.begin(), segLayers.end(), [&](auto &segLayer) {
+                    return segLayer.verts.size() == seg.verts.size() &&
+                           std::all_of(seg.verts.begin(), seg.verts.end(),
+                                       [&](auto &vert) {
+                                           return Contains(segLayer.verts,
+                                                           vert);
+                                       });
+                });
+            if (it != segLayers.end())
+                newSegLayers.push_back(std::move(*it));
+            else
+                newSegLayers.push_back(
+                    {{seg.verts.begin(), seg.verts.end()}, {}});
+        }
+        segLayers.swap(newSegLayers);
+
+        // Schedule segments in parallel and concatenate their schedules
+        std::vector<std::vector<OpRef>> segScheds(segments.size());
+        auto scheduleSegment = [&](size_t i) {
+            // Splitting groups may rule out the best schedule so far, so that
+            // no schedule of this segment fits in the budget
+            for (auto budget : {int64_t(lastCost), MAX_BUDGET}) {
+                HierScheduler scheduler(segments[i], budget, groupMemo,
+                                        segLayers[i].layers);
+                if (segments.size() == 1)
+                    segScheds[i] = scheduler.Schedule<true>();
+                else
+                    segScheds[i] = scheduler.Schedule<false>();
+                if (!segScheds[i].empty()) break;
+            }
+        };
+        ParallelFor(segments.size(), scheduleSegment);
+        std::vector<OpRef> sched;
+        for (auto &segSched : segScheds) Extend(sched, segSched);
         LOG_ASSERT(sched.size() == graph.ops.size());
-        auto stat = ComputeLifetime(sched, graph);
 
-        // Find peak and peak values
+        // Find peak and values alive at peak
         auto peak = EstimatePeak(sched, graph.inputs);
+        auto report = ExplainPeaks(sched, hier);
+        LOG_ASSERT(report.peak == peak);
         std::set<ValueRef> peakValues;
-        auto sizeRange = stat.SizeRange();
-        for (auto it = sizeRange.begin(); it != sizeRange.end(); ++it) {
-            auto size = (*it).second;
-            if (size != peak) continue;
-            for (auto &val : it.AliveValues()) peakValues.insert(val);
-        }
+        for (auto &point : report.points)
+            for (auto &tensor : point.tensors)
+                peakValues.insert(tensor.life.value);
 
-        // Log peak and peak values
+        // Log peak
         LOG_ASSERT(!peakValues.empty());
         LOG(INFO) << "Peak: " << peak / 1024;
-        for (auto &val : peakValues) LOG(INFO) << val->name;
 
-        // Update peak and schedule
-        if (peak < lastPeak) {
-            lastPeak = peak;
+        // Update cost and schedule
+        auto cost = peak;
+        if (objective == SchedObjective::ARENA) {
+            cost = PortfolioPlan(ComputeLifetime(sched, graph)).peak;
+            LOG(INFO) << "Arena: " << cost / 1024;
+        }
+        if (cost < lastCost) {
+            lastCost = cost;
             lastSched = sched;
         }
 
+        // Stop if this schedule is proved optimal
+        if (lastCost <= bound) break;
+
         // Locate sequences related to this peak
         std::unordered_set<SequenceRef> relSeqs;
         for (auto &val : peakValues)
-            relSeqs.insert(hier.opToSeq[val->def.lock()]);
+            if (val->kind == ValueKind::RESULT)
+                relSeqs.insert(hier.opToSeq[val->def.lock()]);
+
+        // Refine groups related to this peak. Groups are split so that most
+        // of their sequences stay grouped and memoized. Once splitting stops
+        // lowering the peak, all groups split from the same original group
+        // are dissolved.
+        auto stalled = peak >= prevPeak;
+        prevPeak = peak;
+        std::vector<GroupRef> removed;
+        std::unordered_set<GroupRef> created;
+        auto remove = [&](const GroupRef &group) {
+            if (!Contains(created, group)) removed.push_back(group);
+        };
+        auto refine = [&](const GroupRef &group,
+                          const std::vector<SequenceRef> &core, bool upward) {
+            auto root = Contains(origins, group) ? origins[group] : group;
+            if (stalled) {
+                for (auto &seq : root->seqs) {
+                    auto cur = seq->group.lock();
+                    if (cur == nullptr) continue;
+                    remove(cur);
+                    ungroup(cur);
+                }
+                return;
+            }
+            remove(group);
+            for (auto &newGroup : splitGroup(group, core, upward)) {
+                created.insert(newGroup);
+                origins.insert({newGroup, root});
+            }
+        };
 
-        // Ungroup
-        bool changed = false;
+        // Separate peak sequences and their descendants from the rest of
+        // their groups
+        std::unordered_map<GroupRef, std::vector<SequenceRef>> peakCores;
         for (auto &seq : relSeqs) {
-            // Ungroups those which contains peak sequences
             auto group = seq->group.lock();
-            if (group != nullptr) {
-                ungroup(group);
-                changed = true;
-            }
+            if (group != nullptr) peakCores[group].push_back(seq);
+        }
+        for (auto &[group, core] : peakCores) refine(group, core, false);
 
-            // Ungroup successor groups of peak sequences
-            changed |= tryUngroupSucc(seq);
+        // Separate consumers of peak sequences and their ancestors from the
+        // rest of successor groups
+        std::unordered_map<GroupRef, std::vector<SequenceRef>> succCores;
+        for (auto &seq : relSeqs) {
+            for (auto &out : seq->outputs) {
+                for (auto &use : out->uses) {
+                    auto &useSeq = hier.opToSeq[use.lock()];
+                    auto group = useSeq->group.lock();
+                    if (group == nullptr || group == seq->group.lock())
+                        continue;
+                    AddUnique(succCores[group], useSeq);
+                }
+            }
+        }
+        for (auto &[group, core] : succCores) {
+            // Earlier refinement may have moved the core to another group
+            auto cur = core.front()->group.lock();
+            if (cur == nullptr) continue;
+            auto inCur = [&](auto &seq) { return cur->Contains(seq); };
+            refine(cur, Filter<std::vector<SequenceRef>>(core, inCur), true);
         }
 
         // Break if nothing more can be done to the graph
-        if (!changed) break;
+        if (removed.empty()) break;
+
+        // Only DP layers after the changed vertices need recomputation
+        for (auto &segLayer : segLayers) {
+            auto segRemoved =
+                Filter<std::vector<GroupRef>>(removed, [&](auto &group) {
+                    return Contains(segLayer.verts, HierVertRef(group));
+                });
+            if (segRemoved.empty()) continue;
+            std::unordered_set<HierVertRef> added;
+            for (auto &group : segRemoved) {
+                for (auto &seq : group->seqs) {
+                    auto top = seq->group.lock();
+                    added.insert(top ? HierVertRef(top) : HierVertRef(seq));
+                }
+            }
+            invalidateLayers(segLayer, segRemoved, added);
+        }
     }
 
     return lastSched;
 }
 
+std::vector<OpRef> WindowSchedule(const Graph &graph, size_t window) {
+    LOG_ASSERT(window > 0);
+
+    // Build hierarchical graph
+    HierGraph hier(graph);
+    RunPass<JoinSequencePass, MakeGroupPass>(hier);
+
+    // Begin with reverse post-order of top level vertices
+    std::deque<HierVertRef> rest;
+    for (auto vert : RpoHierRange(hier))
+        if (!Is<HierInput>(vert) && !Is<HierOutput>(vert))
+            rest.push_back(vert);
+
+    // Initialize boundary state with graph inputs
+    Segment win;
+    for (auto &input : hier.inputs) {
+        auto &val = input->value;
+        win.useCnt.insert({val, val->MemUseCount()});
+    }
+    win.offset = aliveSize(win.useCnt);
+
+    // Slide window along the order. Only the first half of each window is
+    // committed, and the rest is solved again in the next window.
+    GroupMemo groupMemo;
+    std::vector<OpRef> sched;
+    auto stride = std::max(window / 2, size_t(1));
+    while (!rest.empty()) {
+        // Solve this window exactly
+        auto size = std::min(window, rest.size());
+        win.verts.assign(rest.begin(), rest.begin() + size);
+        std::vector<DpLayer> layers;
+        auto winSched =
+            HierScheduler(win, MAX_BUDGET, groupMemo, layers).Schedule<false>();
+
+        // Recover order of top level vertices from op sequence
+        std::vector<std::pair<HierVertRef, size_t>> order;
+        for (auto &op : winSched) {
+            auto &seq = hier.opToSeq[op];
+            auto group = seq->group.lock();
+            auto top = group ? HierVertRef(group) : HierVertRef(seq);
+            if (order.empty() || order.back().first != top)
+                order.push_back({top, 0});
+            order.back().second++;
+        }
+        LOG_ASSERT(order.size() == size);
+
+        // Commit leading vertices and carry boundary state to next window
+        auto nCommit = size == rest.size() ? size : stride;
+        auto nOps = 0u;
+        for (auto i = 0u; i < nCommit; i++) {
+            updateVertUseCount(order[i].first, win.useCnt);
+            nOps += order[i].second;
+        }
+        sched.insert(sched.end(), winSched.begin(), winSched.begin() + nOps);
+        win.offset = aliveSize(win.useCnt);
+
+        // Put uncommitted vertices back in their solved order
+        rest.erase(rest.begin(), rest.begin() + size);
+        for (auto i = size; i > nCommit; i--)
+            rest.push_front(order[i - 1].first);
+    }
+
+    return sched;
+}
+
+std::vector<OpRef> FeasibleSchedule(const Graph &graph, uint64_t budget) {
+    // Budget below lower bound is infeasible for sure
+    if (budget < PeakLowerBound(graph)) return {};
+
+    // Build hierarchical graph
+    HierGraph hier(graph);
+    RunPass<JoinSequencePass, MakeGroupPass>(hier);
+
+    // Search each segment in parallel. The whole graph is infeasible as soon
+    // as one of the segments is.
+    auto segments = splitSegments(hier);
+    GroupMemo groupMemo;
+    std::atomic<bool> failed(false);
+    std::vector<std::vector<OpRef>> segScheds(segments.size());
+    ParallelFor(segments.size(), [&](size_t i) {
+        std::vector<DpLayer> layers;
+        HierScheduler scheduler(segments[i], int64_t(budget), groupMemo,
+                                layers);
+        if (!scheduler.Search(segScheds[i], failed)) failed = true;
+    });
+    if (failed) return {};
+
+    // Concatenate schedules of segments
+    std::vector<OpRef> sched;
+    for (auto &segSched : segScheds) Extend(sched, segSched);
+    LOG_ASSERT(sched.size() == graph.ops.size());
+
+    return sched;
+}
+
+std::vector<OpRef> BisectSchedule(const Graph &graph, uint64_t tolerance) {
+    // Reverse post-order is a feasible schedule to begin with, and any budget
+    // below lower bound is infeasible
+    auto sched = ReversePostOrder(graph);
+    auto hi = EstimatePeak(sched, graph.inputs);
+    auto lo = PeakLowerBound(graph);
+    if (lo == 0) return sched;
+    lo--;
+
+    // Shrink the interval between infeasible and feasible budget
+    while (hi - lo > tolerance) {
+        auto mid = lo + (hi - lo) / 2;
+        auto midSched = FeasibleSchedule(graph, mid);
+        LOG(INFO) << fmt::format("Budget {} KB: {}", mid / 1024,
+                                 midSched.empty() ? "infeasible" : "feasible");
+        if (midSched.empty())
+            lo = mid;
+        else {
+            hi = EstimatePeak(midSched, graph.inputs);
+            sched.swap(midSched);
+        }
+    }
+
+    return sched;
+}
+
 static int64_t sampleGroupPeak(const GroupRef &group,
                                std::unordered_map<ValueRef, uint32_t> useCnt,
                                std::mt19937 &rng) {
@@ -640,7 +1190,7 @@ std::vector<OpRef> SerenitySchedule(const Graph &graph, bool joinOps,
         switch (vert->Kind()) {
             case HierKind::INPUT: {
                 auto input = Cast<HierInput>(vert);
-                useCnt.insert({input->value, input->value->uses.size()});
+                useCnt.insert({input->value, input->value->MemUseCount()});
                 states = MemStateVec(input->value->type.Size());
                 break;
             }
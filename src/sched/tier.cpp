@@ -0,0 +1,251 @@
+#include <hmcos/sched/sched.hpp>
+#include <hmcos/sched/tier.hpp>
+#include <hmcos/util/fmt.hpp>
+
+namespace hmcos {
+
+/// Value kept in slow tier after op at `out` until op at `in`, which are
+/// positions in op schedule. `out` is `Lifetime::TIME_INPUT` if the value is
+/// swapped out before any op runs.
+struct Swap {
+    ValueRef value;
+    int32_t out, in;
+};
+
+/// Events and lifetimes of tiers built from swaps
+struct TierTimeline {
+    std::vector<TierEvent> events;
+    LifetimeStat fastStat, slowStat;
+    /// Position of each event relative to ops. Op at `i` is at `2 * i`, and
+    /// transfers between op `i` and `i + 1` are at `2 * i + 1`.
+    std::vector<int32_t> keys;
+    /// Original values of fast copies created by swap-ins
+    std::unordered_map<ValueRef, ValueRef> origins;
+};
+
+static ValueRef copyValue(const ValueRef &val, const std::string &name) {
+    auto copy = std::make_shared<Value>(*val);
+    copy->name = name;
+    return copy;
+}
+
+class SwapPlanner {
+public:
+    SwapPlanner(const std::vector<OpRef> &sched, const Graph &graph,
+                const TransferCost &cost)
+        : sched(sched), cost(cost), base(ComputeLifetime(sched, graph)) {
+        std::unordered_map<OpRef, int32_t> pos;
+        for (auto [i, op] : EnumRange(sched)) pos.insert({op, int32_t(i)});
+        for (auto &life : base.values) {
+            auto &info = infos[life.value];
+            info.gen = life.gen;
+            life.value->ForEachMemUse(
+                [&](auto &use) { info.uses.push_back(pos.at(use.lock())); });
+            std::sort(info.uses.begin(), info.uses.end());
+        }
+    }
+
+    TierSchedule Plan(uint64_t budget) {
+        // Lifetimes fitting the budget may still be planned to a larger arena
+        // because of fragmentation, so the target of lifetimes is lowered by
+        // the excess of arena until it fits.
+        auto target = budget;
+        while (true) {
+            auto fits = reduce(target);
+            auto tl = build();
+            auto fastPlan = PortfolioPlan(tl.fastStat);
+            if (fastPlan.peak <= budget || !fits || target == 0) {
+                LOG_IF(WARNING, fastPlan.peak > budget) << fmt::format(
+                    "Fast arena {} exceeds budget {} after {} swaps.",
+                    fastPlan.peak, budget, swaps.size());
+                return finish(std::move(tl), std::move(fastPlan));
+            }
+            target -= std::min(target, fastPlan.peak - budget);
+        }
+    }
+
+private:
+    /// Add swaps until peak of fast tier does not exceed the target. Return
+    /// whether it fits.
+    bool reduce(uint64_t target) {
+        while (true) {
+            auto tl = build();
+            MemoryTimeline timeline(tl.fastStat);
+            if (timeline.Peak() <= target) return true;
+
+            // Pick the swap removing the most excess per unit transfer cost
+            auto excess = timeline.Excess(target);
+            std::optional<Swap> best;
+            double bestScore = 0;
+            for (auto &cand : candidates(tl, timeline)) {
+                swaps.push_back(cand);
+                auto newTl = build();
+                auto newExcess = MemoryTimeline(newTl.fastStat).Excess(target);
+                swaps.pop_back();
+                if (newExcess >= excess) continue;
+                auto score = double(excess - newExcess) /
+                             (2 * cost(cand.value->type.Size()));
+                if (score <= bestScore) continue;
+                best = cand;
+                bestScore = score;
+            }
+            if (!best) return false;
+            swaps.push_back(*best);
+        }
+    }
+
+    /// Swaps of values alive across the first peak without being used there.
+    /// Each value is swapped out after its last definition or use before the
+    /// peak, and swapped in before its next use.
+    std::vector<Swap> candidates(const TierTimeline &tl,
+                                 const MemoryTimeline &timeline) const {
+        auto t = timeline.PeakTimes()[0];
+        if (t == Lifetime::TIME_INPUT) return {};
+        auto key = tl.keys[t];
+
+        std::vector<Swap> result;
+        for (auto &fast : timeline.AliveValues(t)) {
+            auto val = Contains(tl.origins, fast) ? tl.origins.at(fast) : fast;
+            // Views address memory relative to their owners, so owners
+            // cannot move
+            if (!val->views.empty()) continue;
+            auto &[gen, uses] = infos.at(val);
+            if (key % 2 == 0 &&
+                std::binary_search(uses.begin(), uses.end(), key / 2))
+                continue;
+            auto next = std::find_if(uses.begin(), uses.end(),
+                                     [&](int32_t u) { return 2 * u > key; });
+            if (next == uses.end()) continue;
+            auto out = next == uses.begin() ? gen : *(next - 1);
+            if (2 * out >= key) continue;
+            // Transfer events of an existing swap are in the same gap
+            if (std::any_of(swaps.begin(), swaps.end(), [&](auto &s) {
+                    return s.value == val && s.out == out;
+                }))
+                continue;
+            result.push_back({val, out, *next});
+        }
+
+        return result;
+    }
+
+    /// Interleave transfers with ops, and split lifetimes of swapped values
+    TierTimeline build() const {
+        // Create events
+        auto nOps = int32_t(sched.size());
+        std::vector<std::vector<size_t>> outAt(nOps + 1), inAt(nOps);
+        for (auto [i, s] : EnumRange(swaps)) {
+            outAt[s.out + 1].push_back(i);
+            inAt[s.in].push_back(i);
+        }
+        TierTimeline tl;
+        std::vector<int32_t> opEvt(nOps), outEvt(swaps.size()),
+            inEvt(swaps.size());
+        auto addEvent = [&](TierEventKind kind, const OpRef &op, int32_t key) {
+            tl.events.push_back({kind, op});
+            tl.keys.push_back(key);
+            return int32_t(tl.events.size() - 1);
+        };
+        for (auto s : outAt[0])
+            outEvt[s] = addEvent(TierEventKind::SWAP_OUT, nullptr, -1);
+        for (auto i = 0; i < nOps; i++) {
+            for (auto s : inAt[i])
+                inEvt[s] = addEvent(TierEventKind::SWAP_IN, nullptr, 2 * i - 1);
+            opEvt[i] = addEvent(TierEventKind::OP, sched[i], 2 * i);
+            for (auto s : outAt[i + 1])
+                outEvt[s] =
+                    addEvent(TierEventKind::SWAP_OUT, nullptr, 2 * i + 1);
+        }
+        auto end = int32_t(tl.events.size());
+
+        // Swaps of each value in order
+        std::unordered_map<ValueRef, std::vector<size_t>> valSwaps;
+        for (auto [i, s] : EnumRange(swaps)) valSwaps[s.value].push_back(i);
+        for (auto &[val, list] : valSwaps)
+            std::sort(list.begin(), list.end(), [&](auto lhs, auto rhs) {
+                return swaps[lhs].out < swaps[rhs].out;
+            });
+
+        // Split lifetimes at swaps
+        for (auto &life : base.values) {
+            auto cur = life.value;
+            auto gen = life.gen == Lifetime::TIME_INPUT ? Lifetime::TIME_INPUT
+                                                        : opEvt[life.gen];
+            auto it = valSwaps.find(life.value);
+            if (it != valSwaps.end()) {
+                for (auto [k, s] : EnumRange(it->second)) {
+                    auto &name = life.value->name;
+                    auto slow =
+                        copyValue(cur, fmt::format("{}:out{}", name, k));
+                    auto fast = copyValue(cur, fmt::format("{}:in{}", name, k));
+                    tl.fastStat.values.push_back({cur, gen, outEvt[s] + 1});
+                    tl.slowStat.values.push_back(
+                        {slow, outEvt[s], inEvt[s] + 1});
+                    tl.events[outEvt[s]].src = cur;
+                    tl.events[outEvt[s]].dst = slow;
+                    tl.events[inEvt[s]].src = slow;
+                    tl.events[inEvt[s]].dst = fast;
+                    tl.origins.insert({fast, life.value});
+                    cur = fast;
+                    gen = inEvt[s];
+                }
+            }
+
+            // A value overlapped by the output of the op killing it is not
+            // alive when the op runs. Otherwise it is freed after its last
+            // use, so that transfers after the use can reuse its space.
+            int32_t kill;
+            auto &uses = infos.at(life.value).uses;
+            if (life.kill >= nOps)
+                kill = end;
+            else if (std::binary_search(uses.begin(), uses.end(), life.kill))
+                kill = opEvt[life.kill];
+            else
+                kill = opEvt[life.kill - 1] + 1;
+            tl.fastStat.values.push_back({cur, gen, kill});
+        }
+
+        for (auto stat : {&tl.fastStat, &tl.slowStat}) {
+            stat->range = {Lifetime::TIME_INPUT, end};
+            std::sort(stat->values.begin(), stat->values.end(), CmpByGenKill);
+        }
+
+        return tl;
+    }
+
+    TierSchedule finish(TierTimeline &&tl, MemoryPlan &&fastPlan) const {
+        auto slowPlan = PortfolioPlan(tl.slowStat);
+        TierSchedule result{std::move(tl.events),  std::move(tl.fastStat),
+                            std::move(tl.slowStat), std::move(fastPlan),
+                            std::move(slowPlan)};
+        for (auto &s : swaps) {
+            auto size = s.value->type.Size();
+            result.transferBytes += 2 * size;
+            result.transferCost += 2 * cost(size);
+        }
+        return result;
+    }
+
+    /// Definition time and sorted use positions of a value owning memory
+    struct ValueInfo {
+        int32_t gen;
+        std::vector<int32_t> uses;
+    };
+
+    const std::vector<OpRef> &sched;
+    const TransferCost &cost;
+    /// Lifetimes without any swap
+    LifetimeStat base;
+    std::unordered_map<ValueRef, ValueInfo> infos;
+    std::vector<Swap> swaps;
+};
+
+TierSchedule TieredSchedule(const Graph &graph, uint64_t budget,
+                            const TransferCost &cost) {
+    // Try to fit the budget without transfers
+    auto sched = FeasibleSchedule(graph, budget);
+    if (sched.empty()) sched = HierarchicalSchedule(graph);
+    return SwapPlanner(sched, graph, cost).Plan(budget);
+}
+
+}  // namespace hmcos
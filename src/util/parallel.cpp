@@ -0,0 +1,30 @@
+#include <algorithm>
+#include <atomic>
+#include <hmcos/util/parallel.hpp>
+#include <thread>
+#include <vector>
+
+namespace hmcos {
+
+void ParallelFor(size_t size, const std::function<void(size_t)> &func) {
+    // Run in calling thread if there is no parallelism to exploit
+    auto nThreads =
+        std::min(size_t(std::max(std::thread::hardware_concurrency(), 1u)),
+                 size);
+    if (nThreads <= 1) {
+        for (auto i = 0u; i < size; i++) func(i);
+        return;
+    }
+
+    // Let each worker fetch next index until all are taken
+    std::atomic<size_t> next(0);
+    auto work = [&]() {
+        for (auto i = next++; i < size; i = next++) func(i);
+    };
+    std::vector<std::thread> workers;
+    for (auto i = 0u; i < nThreads - 1; i++) workers.emplace_back(work);
+    work();
+    for (auto &thread : workers) thread.join();
+}
+
+}  // namespace hmcos